@@ -14,6 +14,19 @@ const char* default_files[] = {
 const size_t default_files_count
     = sizeof(default_files) / sizeof(*default_files);
 
+unsigned parse_options = sajson::PARSE_DEFAULT;
+// Whether each iteration maps the file with parse_file rather than parsing
+// a copy already in memory.
+bool mapped = false;
+// If nonzero, each iteration feeds the input to a push_parser in chunks of
+// this many bytes.
+size_t push_chunk_size = 0;
+// Whether to parse with dynamic_allocation, pooled_allocation, or
+// virtual_allocation rather than single_allocation.
+bool dynamic = false;
+bool pooled = false;
+bool virtual_memory = false;
+
 template <typename AllocationStrategy>
 void run_benchmark(size_t max_string_length, const char* filename) {
     FILE* file = fopen(filename, "rb");
@@ -49,8 +62,27 @@ void run_benchmark(size_t max_string_length, const char* filename) {
     const size_t N = 1000;
     for (size_t i = 0; i < N; ++i) {
         clock_t before_each = clock();
-        sajson::parse(
-            AllocationStrategy(), sajson::string(buffer.data(), buffer.size()));
+        if (push_chunk_size) {
+            AllocationStrategy strategy;
+            sajson::push_parser<AllocationStrategy> parser(
+                strategy, parse_options, buffer.size());
+            for (size_t offset = 0; offset < buffer.size();
+                 offset += push_chunk_size) {
+                parser.feed(
+                    buffer.data() + offset,
+                    std::min(push_chunk_size, buffer.size() - offset));
+            }
+            parser.finish();
+#ifdef SAJSON_MMAP
+        } else if (mapped) {
+            sajson::parse_file(AllocationStrategy(), filename, parse_options);
+#endif
+        } else {
+            sajson::parse(
+                AllocationStrategy(),
+                sajson::string(buffer.data(), buffer.size()),
+                parse_options);
+        }
         clock_t elapsed_each = clock() - before_each;
         minimum_each = std::min(minimum_each, elapsed_each);
     }
@@ -91,16 +123,47 @@ void run_all(size_t files_count, const char** files) {
 }
 
 int main(int argc, const char** argv) {
+    for (; argc > 1 && !strncmp(argv[1], "--", 2); --argc, ++argv) {
+        if (!strcmp(argv[1], "--lazy-strings")) {
+            parse_options |= sajson::PARSE_LAZY_STRINGS;
+        } else if (!strcmp(argv[1], "--lazy-numbers")) {
+            parse_options |= sajson::PARSE_LAZY_NUMBERS;
+        } else if (!strcmp(argv[1], "--read-only-input")) {
+            parse_options |= sajson::PARSE_READ_ONLY_INPUT;
+        } else if (!strcmp(argv[1], "--dynamic")) {
+            dynamic = true;
+        } else if (!strcmp(argv[1], "--pooled")) {
+            pooled = true;
+        } else if (!strcmp(argv[1], "--push-chunk") && argc > 2) {
+            push_chunk_size = strtoul(argv[2], 0, 10);
+            --argc;
+            ++argv;
+#ifdef SAJSON_MMAP
+        } else if (!strcmp(argv[1], "--mapped")) {
+            mapped = true;
+        } else if (!strcmp(argv[1], "--virtual")) {
+            virtual_memory = true;
+#endif
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[1]);
+            return 1;
+        }
+    }
+    size_t files_count = default_files_count;
+    const char** files = default_files;
     if (argc > 1) {
-        // printf("\n=== SINGLE ALLOCATION ===\n\n");
-        run_all<sajson::single_allocation>(argc - 1, argv + 1);
-        // printf("\n=== DYNAMIC ALLOCATION ===\n\n");
-        // run_all<sajson::dynamic_allocation>(argc - 1, argv + 1);
+        files_count = argc - 1;
+        files = argv + 1;
+    }
+    if (dynamic) {
+        run_all<sajson::dynamic_allocation>(files_count, files);
+    } else if (pooled) {
+        run_all<sajson::pooled_allocation>(files_count, files);
+#ifdef SAJSON_MMAP
+    } else if (virtual_memory) {
+        run_all<sajson::virtual_allocation>(files_count, files);
+#endif
     } else {
-        // printf("\n=== SINGLE ALLOCATION ===\n\n");
-        run_all<sajson::single_allocation>(default_files_count, default_files);
-        // printf("\n=== DYNAMIC ALLOCATION ===\n\n");
-        // run_all<sajson::dynamic_allocation>(default_files_count,
-        // default_files);
+        run_all<sajson::single_allocation>(files_count, files);
     }
 }
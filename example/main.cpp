@@ -82,6 +82,8 @@ void traverse(jsonstats& stats, const sajson::value& node) {
 
     case TYPE_DOUBLE:
     case TYPE_INTEGER:
+    case TYPE_INT64:
+    case TYPE_UINT64:
         ++stats.number_count;
         stats.total_number_value += node.get_number_value();
         break;
@@ -92,6 +94,17 @@ void traverse(jsonstats& stats, const sajson::value& node) {
 }
 
 int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s file.json\n", argv[0]);
+        return 1;
+    }
+
+#ifdef SAJSON_MMAP
+    // Map the file instead of reading it, and leave it untouched, so the
+    // only memory the parse needs beyond the page cache is the AST.
+    const sajson::document& document = sajson::parse_file(
+        sajson::dynamic_allocation(), argv[1], PARSE_READ_ONLY_INPUT);
+#else
     FILE* file = fopen(argv[1], "rb");
     if (!file) {
         fprintf(stderr, "Failed to open file\n");
@@ -102,19 +115,21 @@ int main(int argc, char** argv) {
     fseek(file, 0, SEEK_SET);
 
     char* buffer = new char[length];
-    if (length != fread(buffer, 1, length, file)) {
-        fclose(file);
+    size_t read = fread(buffer, 1, length, file);
+    fclose(file);
+    if (read != length) {
         delete[] buffer;
         fprintf(stderr, "Failed to read entire file\n");
         return 1;
     }
-    fclose(file);
 
     const sajson::document& document = sajson::parse(
         sajson::dynamic_allocation(), mutable_string_view(length, buffer));
+#endif
     if (!success(document)) {
-        fclose(file);
+#ifndef SAJSON_MMAP
         delete[] buffer;
+#endif
         return 1;
     }
 
@@ -127,8 +142,9 @@ int main(int argc, char** argv) {
     printf("number count: %d\n", (int)stats.number_count);
     printf("string count: %d\n", (int)stats.string_count);
     printf("null count: %d\n", (int)stats.null_count);
-    
-    fclose(file);
+
+#ifndef SAJSON_MMAP
     delete[] buffer;
+#endif
     return 0;
 }
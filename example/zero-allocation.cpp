@@ -24,7 +24,7 @@ int main() {
           "CVG Viewer...\"}]}}";
 
     const size_t AST_BUFFER_SIZE = 500;
-    size_t ast_buffer[AST_BUFFER_SIZE];
+    sajson::ast_word ast_buffer[AST_BUFFER_SIZE];
 
     const document& doc = parse(
         // The bounded allocation mode attempts to fit the AST into the given
@@ -22,6 +22,10 @@ inline std::ostream& operator<<(std::ostream& os, type t) {
         return os << "<array>";
     case TYPE_OBJECT:
         return os << "<object>";
+    case TYPE_INT64:
+        return os << "<int64>";
+    case TYPE_UINT64:
+        return os << "<uint64>";
     default:
         return os << "<unknown type>";
     }
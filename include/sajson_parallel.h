@@ -0,0 +1,683 @@
+#pragma once
+
+#include "sajson.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sajson {
+
+/// Settings for parse_lines_parallel.
+struct parallel_options {
+    parallel_options()
+        : thread_count(0)
+        , chunk_size(1 << 20)
+        , in_order(true)
+        , parse_options(PARSE_DEFAULT) {}
+
+    /// The number of threads to parse on, or 0 for one per hardware thread.
+    unsigned thread_count;
+
+    /// About how many bytes of input a thread takes at a time.  Chunks are
+    /// extended to the end of a line, or, in parse_parallel, to a comma
+    /// between elements of the root array.
+    size_t chunk_size;
+
+    /// In parse_lines_parallel, whether documents are visited in input
+    /// order on the calling thread, or as soon as they are parsed,
+    /// concurrently on the parsing threads.
+    bool in_order;
+
+    /// Options for each document's parse, as in parse().
+    unsigned parse_options;
+};
+
+namespace internal {
+
+inline unsigned get_thread_count(const parallel_options& options) {
+    unsigned thread_count = options.thread_count
+        ? options.thread_count
+        : std::thread::hardware_concurrency();
+    return thread_count ? thread_count : 1;
+}
+
+/// Calls f(i) for every i in [0, count) on up to thread_count threads,
+/// counting the calling thread.  Each thread takes the next i whenever it
+/// finishes one.
+template <typename Function>
+void parallel_for(unsigned thread_count, size_t count, Function&& f) {
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            f(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < thread_count && t < count; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/// Divides newline-delimited input into chunks of about chunk_size bytes
+/// that begin at the start of a line.  Chunk i begins after the first line
+/// break at or after byte i * chunk_size - 1 and ends where chunk i + 1
+/// begins; if a line spans several nominal chunks, all but one of them are
+/// empty.
+///
+/// Every boundary is found before parsing starts, which costs one short
+/// scan per chunk: parsing unescapes strings in place, and an unescaped \n
+/// in a neighbouring chunk would look like a line break.
+class line_chunks {
+public:
+    line_chunks(const char* data, size_t length, size_t chunk_size) {
+        if (!chunk_size) {
+            chunk_size = 1;
+        }
+        size_t count = length / chunk_size + (length % chunk_size != 0);
+        begins.reserve(count + 1);
+        begins.push_back(0);
+        for (size_t i = 1; i < count; ++i) {
+            size_t from = i * chunk_size - 1;
+            if (from < begins.back()) {
+                begins.push_back(begins.back());
+                continue;
+            }
+            const void* line_break = memchr(data + from, '\n', length - from);
+            begins.push_back(
+                line_break
+                    ? static_cast<const char*>(line_break) - data + 1
+                    : length);
+        }
+        begins.push_back(length);
+    }
+
+    size_t get_count() const {
+        return begins.size() - 1;
+    }
+
+    size_t get_begin(size_t i) const {
+        return begins[i];
+    }
+
+private:
+    std::vector<size_t> begins;
+};
+
+/// Calls f(offset, line) for every line in [begin, end) of data that is not
+/// blank.
+template <typename Function>
+void for_each_line(char* data, size_t begin, size_t end, Function&& f) {
+    while (begin < end) {
+        char* line = data + begin;
+        char* line_break
+            = static_cast<char*>(memchr(line, '\n', end - begin));
+        char* line_end = line_break ? line_break : data + end;
+        for (char* p = line; p != line_end; ++p) {
+            if (!is_whitespace(*p)) {
+                f(begin, mutable_string_view(line_end - line, line));
+                break;
+            }
+        }
+        begin = line_end - data + 1;
+    }
+}
+
+/// The documents of one chunk, kept until the calling thread visits them.
+/// Visited chunks are recycled, so their arenas are only allocated and
+/// faulted in once.
+struct parsed_chunk {
+    parsed_chunk()
+        : capacity(0) {}
+
+    // One word per byte of the chunk, like single_allocation, divided among
+    // its lines.
+    std::unique_ptr<ast_word[]> arena;
+    size_t capacity;
+    std::vector<std::pair<size_t, document>> documents;
+};
+
+// parse_parallel finds where to split the root array in two passes over
+// fixed-size chunks of the input, each on every thread.  The first learns
+// how each chunk changes the nesting depth without knowing whether the
+// chunk begins inside a string, which only the chunks before it decide;
+// the second, knowing, finds the commas directly inside the root array.
+
+/// Per-byte bitmasks of what decides where a 64-byte block can be split.
+struct split_masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t open; // [ and {
+    uint64_t close; // ] and }
+    uint64_t comma;
+};
+
+// [ and {, and ] and }, differ only in bit 5.
+inline void classify_split_block(const char* p, split_masks& masks) {
+#if defined(SAJSON_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i bit_5 = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i comma = _mm256_set1_epi8(',');
+    masks = split_masks();
+    for (unsigned i = 0; i < 64; i += 32) {
+        __m256i v
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i folded = _mm256_or_si256(v, bit_5);
+        auto mask = [&](__m256i bytes) {
+            return uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(bytes)))
+                << i;
+        };
+        masks.quote |= mask(_mm256_cmpeq_epi8(v, quote));
+        masks.backslash |= mask(_mm256_cmpeq_epi8(v, backslash));
+        masks.open |= mask(_mm256_cmpeq_epi8(folded, open));
+        masks.close |= mask(_mm256_cmpeq_epi8(folded, close));
+        masks.comma |= mask(_mm256_cmpeq_epi8(v, comma));
+    }
+#elif defined(SAJSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i bit_5 = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i comma = _mm_set1_epi8(',');
+    masks = split_masks();
+    for (unsigned i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i folded = _mm_or_si128(v, bit_5);
+        auto mask = [&](__m128i bytes) {
+            return uint64_t(_mm_movemask_epi8(bytes)) << i;
+        };
+        masks.quote |= mask(_mm_cmpeq_epi8(v, quote));
+        masks.backslash |= mask(_mm_cmpeq_epi8(v, backslash));
+        masks.open |= mask(_mm_cmpeq_epi8(folded, open));
+        masks.close |= mask(_mm_cmpeq_epi8(folded, close));
+        masks.comma |= mask(_mm_cmpeq_epi8(v, comma));
+    }
+#else
+    masks = split_masks();
+    for (unsigned i = 0; i < 64; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (p[i]) {
+        case '"':
+            masks.quote |= bit;
+            break;
+        case '\\':
+            masks.backslash |= bit;
+            break;
+        case '[':
+        case '{':
+            masks.open |= bit;
+            break;
+        case ']':
+        case '}':
+            masks.close |= bit;
+            break;
+        case ',':
+            masks.comma |= bit;
+            break;
+        }
+    }
+#endif
+}
+
+/// Whether the byte at p follows an odd run of backslashes, which may
+/// begin in an earlier chunk.  A backslash is only valid in a string, so
+/// this does not depend on whether p is in one.
+inline bool is_escaped(const char* data, const char* p) {
+    const char* run = p;
+    while (run != data && run[-1] == '\\') {
+        --run;
+    }
+    return (p - run) % 2 != 0;
+}
+
+/// Calls f(offset, masks, in_string) for each 64-byte block of [begin,
+/// end) of data, where in_string marks the bytes inside strings, given
+/// whether the range begins in one.
+template <typename Function>
+bool scan_blocks(
+    const char* data, size_t begin, size_t end, bool in_string, Function&& f) {
+    uint64_t prev_escaped = is_escaped(data, data + begin);
+    uint64_t prev_in_string = in_string ? ~uint64_t(0) : 0;
+    for (size_t offset = begin; offset < end; offset += 64) {
+        split_masks masks;
+        if (end - offset >= 64) {
+            classify_split_block(data + offset, masks);
+        } else {
+            // Pad the final block with whitespace, which is never split on.
+            char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, data + offset, end - offset);
+            classify_split_block(tail, masks);
+        }
+        uint64_t escaped = find_escaped(masks.backslash, prev_escaped);
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t block_in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = 0 - (block_in_string >> 63);
+        f(offset, masks, block_in_string);
+    }
+    return prev_in_string != 0;
+}
+
+struct chunk_summary {
+    // Whether the chunk has an odd number of unescaped quotes.
+    bool toggles_string;
+    // Indexed by whether the chunk begins inside a string.
+    ptrdiff_t depth_change[2];
+};
+
+inline chunk_summary
+summarize_chunk(const char* data, size_t begin, size_t end) {
+    chunk_summary summary = {false, {0, 0}};
+    summary.toggles_string = scan_blocks(
+        data,
+        begin,
+        end,
+        false,
+        [&](size_t, const split_masks& masks, uint64_t in_string) {
+            summary.depth_change[0] += count_set_bits(masks.open & ~in_string);
+            summary.depth_change[0]
+                -= count_set_bits(masks.close & ~in_string);
+            summary.depth_change[1] += count_set_bits(masks.open & in_string);
+            summary.depth_change[1] -= count_set_bits(masks.close & in_string);
+        });
+    return summary;
+}
+
+struct chunk_commas {
+    // The first comma directly inside the root array, if count is nonzero.
+    size_t first;
+    size_t count;
+};
+
+inline chunk_commas find_root_array_commas(
+    const char* data,
+    size_t begin,
+    size_t end,
+    bool in_string,
+    ptrdiff_t depth) {
+    chunk_commas commas = {0, 0};
+    auto count = [&](size_t offset, uint64_t mask) {
+        if (mask) {
+            if (!commas.count) {
+                commas.first = offset + count_trailing_zeroes(mask);
+            }
+            commas.count += count_set_bits(mask);
+        }
+    };
+    scan_blocks(
+        data,
+        begin,
+        end,
+        in_string,
+        [&](size_t offset, const split_masks& masks, uint64_t in_string) {
+            // The depth only changes at brackets, so count the commas
+            // between each pair of them at once.
+            uint64_t brackets = (masks.open | masks.close) & ~in_string;
+            uint64_t remaining = masks.comma & ~in_string;
+            while (brackets) {
+                uint64_t bracket = brackets & (0 - brackets);
+                uint64_t before = remaining & (bracket - 1);
+                if (depth == 1) {
+                    count(offset, before);
+                }
+                remaining &= ~before;
+                depth += (masks.open & bracket) ? 1 : -1;
+                brackets ^= bracket;
+            }
+            if (depth == 1) {
+                count(offset, remaining);
+            }
+        });
+    return commas;
+}
+
+typedef parser<single_allocation::allocator> array_parser;
+
+/// A run of the root array's elements that parse_parallel parses on its
+/// own, into words reserved in the final document's AST.
+struct array_slice {
+    array_slice(
+        const mutable_string_view& input,
+        unsigned options,
+        ast_word* words,
+        size_t word_count,
+        size_t begin_,
+        size_t end_,
+        size_t length_)
+        : state(
+              input,
+              single_allocation::allocator(words, word_count, false),
+              options)
+        , stack_succeeded(false)
+        , stack(state.get_stack_head(&stack_succeeded))
+        , begin(begin_)
+        , end(end_)
+        , length(length_)
+        , succeeded(false) {}
+
+    void parse() {
+        succeeded = (begin == 0 || state.enter_root_array(begin, stack))
+            && state.parse_root_array_elements(end, length, stack);
+    }
+
+    array_parser state;
+    bool stack_succeeded;
+    single_allocation::stack_head stack;
+    // The slice is [begin, end) of the input, ending just after a comma of
+    // the root array, and has length of its elements.
+    size_t begin;
+    size_t end;
+    size_t length;
+    bool succeeded;
+};
+
+} // namespace internal
+
+/**
+ * Parses newline-delimited JSON (JSON Lines) on several threads, calling
+ * visitor(offset, document) for each line that is not blank, where offset
+ * is where the line begins in the input.  Each line is parsed on its own,
+ * so an invalid line is visited as an invalid document and the lines after
+ * it are still parsed.  Error lines and columns are relative to the line.
+ *
+ * The input is cut into chunks at line breaks, and each thread takes the
+ * next unparsed chunk whenever it finishes one, so lines of uneven length
+ * still keep every thread busy.
+ *
+ * With options.in_order, the visitor runs on the calling thread, in input
+ * order.  Each chunk is parsed into an arena of one word per input byte
+ * that stays alive until its documents are visited; at most a few chunks
+ * per thread are in flight at once, and their arenas are reused.
+ * Otherwise, the visitor runs on the parsing threads as soon as each
+ * document is parsed, so it must be safe to call concurrently, and each
+ * document is only valid during the call.  Every thread then parses into
+ * its own buffer, reused from line to line.
+ */
+template <typename Visitor>
+void parse_lines_parallel(
+    const mutable_string_view& input,
+    Visitor&& visitor,
+    const parallel_options& options = parallel_options()) {
+    char* data = input.get_data();
+    const internal::line_chunks chunks(
+        data, input.length(), options.chunk_size);
+    const size_t chunk_count = chunks.get_count();
+    const unsigned parse_options = options.parse_options;
+
+    const unsigned thread_count = internal::get_thread_count(options);
+
+    std::atomic<size_t> next_chunk(0);
+    std::vector<std::thread> threads;
+
+    if (!options.in_order) {
+        auto work = [&] {
+            internal::reusable_buffer buffer;
+            for (;;) {
+                size_t i = next_chunk++;
+                if (i >= chunk_count) {
+                    return;
+                }
+                internal::for_each_line(
+                    data,
+                    chunks.get_begin(i),
+                    chunks.get_begin(i + 1),
+                    [&](size_t offset, const mutable_string_view& line) {
+                        bool success;
+                        visitor(
+                            offset,
+                            internal::parse_with(
+                                line,
+                                internal::reusable_allocation(buffer)
+                                    .make_allocator(line.length(), &success),
+                                parse_options));
+                    });
+            }
+        };
+        for (unsigned t = 1; t < thread_count; ++t) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return;
+    }
+
+    // Threads wait rather than parse more than window chunks ahead of the
+    // visitor, which bounds the memory held by parsed chunks.
+    const size_t window = 2 * size_t(thread_count);
+    std::vector<std::unique_ptr<internal::parsed_chunk>> parsed(chunk_count);
+    std::vector<std::unique_ptr<internal::parsed_chunk>> recycled;
+    size_t visited = 0;
+    std::mutex mutex;
+    std::condition_variable chunk_ready;
+    std::condition_variable chunk_visited;
+
+    auto work = [&] {
+        for (;;) {
+            size_t i = next_chunk++;
+            if (i >= chunk_count) {
+                return;
+            }
+            std::unique_ptr<internal::parsed_chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                chunk_visited.wait(lock, [&] { return i < visited + window; });
+                if (!recycled.empty()) {
+                    chunk = std::move(recycled.back());
+                    recycled.pop_back();
+                }
+            }
+            if (!chunk) {
+                chunk.reset(new internal::parsed_chunk);
+            }
+
+            size_t begin = chunks.get_begin(i);
+            size_t end = chunks.get_begin(i + 1);
+            if (chunk->capacity < end - begin) {
+                chunk->arena.reset(new ast_word[end - begin]);
+                chunk->capacity = end - begin;
+            }
+            ast_word* arena_top = chunk->arena.get() + (end - begin);
+            internal::for_each_line(
+                data,
+                begin,
+                end,
+                [&](size_t offset, const mutable_string_view& line) {
+                    arena_top -= line.length();
+                    bool success;
+                    chunk->documents.emplace_back(
+                        offset,
+                        internal::parse_with(
+                            line,
+                            single_allocation(arena_top, line.length())
+                                .make_allocator(line.length(), &success),
+                            parse_options));
+                });
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                parsed[i] = std::move(chunk);
+            }
+            chunk_ready.notify_one();
+        }
+    };
+    for (unsigned t = 0; t < thread_count; ++t) {
+        threads.emplace_back(work);
+    }
+
+    for (size_t i = 0; i < chunk_count; ++i) {
+        std::unique_ptr<internal::parsed_chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunk_ready.wait(lock, [&] { return parsed[i] != nullptr; });
+            chunk = std::move(parsed[i]);
+        }
+        for (auto& entry : chunk->documents) {
+            visitor(entry.first, static_cast<const document&>(entry.second));
+        }
+        chunk->documents.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            recycled.push_back(std::move(chunk));
+            ++visited;
+        }
+        chunk_visited.notify_all();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * Parses one large document on several threads.  If its root is an array,
+ * it is split at commas between its elements into runs of about
+ * options.chunk_size bytes, which are parsed concurrently, each into its
+ * own part of a single AST buffer; then the root array is assembled from
+ * their elements.  The resulting document is the same as parse() would
+ * return, errors included.
+ *
+ * The AST buffer has a word per input byte, as with single_allocation, and
+ * two more per element of the root array.  Other documents, small ones,
+ * and options.parse_options with PARSE_READ_ONLY_INPUT are parsed on the
+ * calling thread with single_allocation.
+ */
+template <typename StringType>
+document parse_parallel(
+    const StringType& string,
+    const parallel_options& options = parallel_options()) {
+    const unsigned parse_options = options.parse_options;
+    mutable_string_view input
+        = internal::make_input_view(string, parse_options);
+    char* const data = input.get_data();
+    const size_t length = input.length();
+    const size_t chunk_size = options.chunk_size ? options.chunk_size : 1;
+    const size_t chunk_count = length / chunk_size + (length % chunk_size != 0);
+    const unsigned thread_count = internal::get_thread_count(options);
+
+    size_t root = 0;
+    while (root != length && internal::is_whitespace(data[root])) {
+        ++root;
+    }
+    if ((parse_options & PARSE_READ_ONLY_INPUT) || thread_count < 2
+        || chunk_count < 2 || root == length || data[root] != '[') {
+        return parse(single_allocation(), input, parse_options);
+    }
+
+    auto chunk_end = [&](size_t i) {
+        return i + 1 < chunk_count ? (i + 1) * chunk_size : length;
+    };
+    std::vector<internal::chunk_summary> summaries(chunk_count);
+    internal::parallel_for(thread_count, chunk_count, [&](size_t i) {
+        summaries[i]
+            = internal::summarize_chunk(data, i * chunk_size, chunk_end(i));
+    });
+    std::vector<internal::chunk_commas> commas(chunk_count);
+    std::unique_ptr<bool[]> starts_in_string(new bool[chunk_count]);
+    std::unique_ptr<ptrdiff_t[]> starting_depth(new ptrdiff_t[chunk_count]);
+    bool in_string = false;
+    ptrdiff_t depth = 0;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        starts_in_string[i] = in_string;
+        starting_depth[i] = depth;
+        depth += summaries[i].depth_change[in_string];
+        in_string ^= summaries[i].toggles_string;
+    }
+    internal::parallel_for(thread_count, chunk_count, [&](size_t i) {
+        commas[i] = internal::find_root_array_commas(
+            data,
+            i * chunk_size,
+            chunk_end(i),
+            starts_in_string[i],
+            starting_depth[i]);
+    });
+
+    // Split at the first such comma in each chunk after the first.  The
+    // elements before the last split are on the final parser's stack and
+    // in the root array at once, hence the two extra words per element.
+    struct split {
+        size_t end;
+        size_t element_count;
+    };
+    std::vector<split> splits;
+    size_t elements_before_chunk = commas[0].count;
+    size_t element_count = 0;
+    size_t slice_words = 0;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        if (commas[i].count) {
+            size_t begin = splits.empty() ? 0 : splits.back().end;
+            size_t end = commas[i].first + 1;
+            size_t elements = elements_before_chunk + 1;
+            splits.push_back(split{end, elements - element_count});
+            element_count = elements;
+            slice_words += end - begin + 1;
+        }
+        elements_before_chunk += commas[i].count;
+    }
+    if (splits.empty()) {
+        return parse(single_allocation(), input, parse_options);
+    }
+    const size_t rest = splits.back().end;
+
+    bool success;
+    auto allocator = single_allocation().make_allocator(
+        slice_words + length - rest + 1 + 2 * element_count, &success);
+    if (!success) {
+        return parse(single_allocation(), input, parse_options);
+    }
+    internal::array_parser state(input, std::move(allocator), parse_options);
+    auto stack = state.get_stack_head(&success);
+    ast_word* words = state.reserve_ast(slice_words, &success);
+
+    // Copying the input view touches its reference count, so the parsers
+    // are made and destroyed on this thread.
+    std::vector<std::unique_ptr<internal::array_slice>> slices;
+    size_t begin = 0;
+    for (const split& s : splits) {
+        size_t word_count = s.end - begin + 1;
+        slices.emplace_back(new internal::array_slice(
+            input,
+            parse_options,
+            words,
+            word_count,
+            begin,
+            s.end,
+            s.element_count));
+        words += word_count;
+        begin = s.end;
+    }
+    internal::parallel_for(thread_count, slices.size(), [&](size_t i) {
+        slices[i]->parse();
+    });
+
+    for (auto& slice : slices) {
+        if (!slice->succeeded) {
+            return slice->state.make_document(false);
+        }
+    }
+    if (!state.enter_root_array(rest, stack)) {
+        return state.make_document(false);
+    }
+    for (auto& slice : slices) {
+        if (!state.take_root_array_elements(
+                slice->state, slice->stack, stack)) {
+            return state.make_document(false);
+        }
+    }
+    return state.make_document(state.parse_more(input, length, true, stack));
+}
+
+} // namespace sajson
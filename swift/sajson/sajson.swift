@@ -11,6 +11,8 @@ import Foundation
 public enum ValueReader {
     case integer(Int32)
     case double(Float64)
+    case int64(Int64)
+    case uint64(UInt64)
     case null
     case bool(Bool)
     case string(String)
@@ -22,6 +24,8 @@ public enum ValueReader {
         switch self {
         case .integer(let i): return .integer(i)
         case .double(let d): return .double(d)
+        case .int64(let i): return .int64(i)
+        case .uint64(let u): return .uint64(u)
         case .null: return .null
         case .bool(let b): return .bool(b)
         case .string(let s): return .string(s)
@@ -46,6 +50,8 @@ public enum ValueReader {
         switch self {
         case .integer(let i): return i
         case .double(let d): return d
+        case .int64(let i): return i
+        case .uint64(let u): return u
         case .null: return NSNull()
         case .bool(let b): return b
         case .string(let s): return s
@@ -79,8 +85,8 @@ public struct ArrayReader: Sequence {
         }
 
         let element = payload[1 + i]
-        let elementTag = UInt8(element & 7)
-        let elementOffset = Int(element >> 3)
+        let elementTag = UInt8(element & 15)
+        let elementOffset = Int(element >> 4)
         return ASTNode(tag: elementTag, payload: payload.advanced(by: elementOffset), input: input).valueReader
     }
 
@@ -141,8 +147,8 @@ public struct ObjectReader: Sequence {
 
         let key = decodeString(input, start, end)
 
-        let valueTag = UInt8(value & 7)
-        let valueOffset = Int(value >> 3)
+        let valueTag = UInt8(value & 15)
+        let valueOffset = Int(value >> 4)
         return (key, ASTNode(tag: valueTag, payload: payload.advanced(by: valueOffset), input: input).valueReader)
     }
 
@@ -153,8 +159,8 @@ public struct ObjectReader: Sequence {
         }
 
         let element = payload[3 + objectLocation * 3]
-        let elementTag = UInt8(element & 7)
-        let elementOffset = Int(element >> 3)
+        let elementTag = UInt8(element & 15)
+        let elementOffset = Int(element >> 4)
         return ASTNode(tag: elementTag, payload: payload.advanced(by: elementOffset), input: input).valueReader
     }
 
@@ -169,8 +175,8 @@ public struct ObjectReader: Sequence {
 
             let key = decodeString(input, start, end)
 
-            let valueTag = UInt8(value & 7)
-            let valueOffset = Int(value >> 3)
+            let valueTag = UInt8(value & 15)
+            let valueOffset = Int(value >> 4)
             result[key] = ASTNode(tag: valueTag, payload: payload.advanced(by: valueOffset), input: input).valueReader
         }
         return result
@@ -214,6 +220,8 @@ public struct ObjectReader: Sequence {
 public enum Value {
     case integer(Int32)
     case double(Float64)
+    case int64(Int64)
+    case uint64(UInt64)
     case null
     case bool(Bool)
     case string(String)
@@ -233,6 +241,8 @@ private struct ASTNode {
         static let string: UInt8 = 5
         static let array: UInt8 = 6
         static let object: UInt8 = 7
+        static let int64: UInt8 = 8
+        static let uint64: UInt8 = 9
     }
     
     fileprivate init(tag: UInt8, payload: UnsafePointer<UInt>, input: UnsafeBufferPointer<UInt8>) {
@@ -249,14 +259,11 @@ private struct ASTNode {
                 return .integer(p[0])
             }
         case RawTag.double:
-            if MemoryLayout<Int>.size == MemoryLayout<Int32>.size {
-                let lo = UInt64(payload[0])
-                let hi = UInt64(payload[1])
-                let bitPattern = lo | (hi << 32)
-                return .double(Float64(bitPattern: bitPattern))
-            } else {
-                return .double(Float64(bitPattern: UInt64(payload[0])))
-            }
+            return .double(Float64(bitPattern: read64BitPayload()))
+        case RawTag.int64:
+            return .int64(Int64(bitPattern: read64BitPayload()))
+        case RawTag.uint64:
+            return .uint64(read64BitPayload())
         case RawTag.null:
             return .null
         case RawTag.bfalse:
@@ -279,6 +286,16 @@ private struct ASTNode {
 
     // MARK: Private
 
+    private func read64BitPayload() -> UInt64 {
+        if MemoryLayout<Int>.size == MemoryLayout<Int32>.size {
+            let lo = UInt64(payload[0])
+            let hi = UInt64(payload[1])
+            return lo | (hi << 32)
+        } else {
+            return UInt64(payload[0])
+        }
+    }
+
     private let tag: UInt8
     private let payload: UnsafePointer<UInt>
     private let input: UnsafeBufferPointer<UInt8>
@@ -91,6 +91,16 @@ class sajsonTests: XCTestCase {
         }
     }
 
+    func test_64bit_integers() {
+        let doc = try! parse(allocationStrategy: .single, input: "[1496756396000, -9223372036854775808, 18446744073709551615]")
+        doc.withRootValueReader { docValue in
+            guard case .array(let array) = docValue else { XCTFail(); return }
+            guard case .int64(1496756396000) = array[0] else { XCTFail(); return }
+            guard case .int64(Int64.min) = array[1] else { XCTFail(); return }
+            guard case .uint64(UInt64.max) = array[2] else { XCTFail(); return }
+        }
+    }
+
     // MARK: Helpers
 
     func createLargeTestJsonData(objectCount: Int) -> Data {
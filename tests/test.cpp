@@ -1,10 +1,17 @@
 // included first to verify sajson includes.
 #include <sajson.h>
 #include <sajson_ostream.h>
+#include <sajson_parallel.h>
 
 #include <UnitTest++.h>
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
 
 using sajson::document;
 using sajson::literal;
@@ -13,12 +20,20 @@ using sajson::TYPE_ARRAY;
 using sajson::TYPE_DOUBLE;
 using sajson::TYPE_FALSE;
 using sajson::TYPE_INTEGER;
+using sajson::TYPE_INT64;
 using sajson::TYPE_NULL;
 using sajson::TYPE_OBJECT;
 using sajson::TYPE_STRING;
 using sajson::TYPE_TRUE;
+using sajson::TYPE_UINT64;
 using sajson::value;
 
+// Some tests check that allocations too large to satisfy are reported as
+// ERROR_OUT_OF_MEMORY, which AddressSanitizer aborts on by default.
+extern "C" const char* __asan_default_options() {
+    return "allocator_may_return_null=1";
+}
+
 namespace {
 
 inline bool success(const document& doc) {
@@ -35,7 +50,34 @@ inline bool success(const document& doc) {
 }
 
 const size_t ast_buffer_size = 8096;
-size_t ast_buffer[ast_buffer_size];
+sajson::ast_word ast_buffer[ast_buffer_size];
+
+sajson::parse_context shared_context;
+
+// memory_callbacks that count what they allocate and free.
+struct counted_memory {
+    size_t allocations = 0;
+    size_t live_bytes = 0;
+
+    static void* allocate(void* context, size_t size) {
+        auto self = static_cast<counted_memory*>(context);
+        ++self->allocations;
+        self->live_bytes += size;
+        return malloc(size);
+    }
+
+    static void deallocate(void* context, void* block, size_t size) {
+        auto self = static_cast<counted_memory*>(context);
+        self->live_bytes -= size;
+        free(block);
+    }
+
+    sajson::memory_callbacks callbacks() {
+        return sajson::memory_callbacks{ allocate, deallocate, this };
+    }
+};
+
+counted_memory shared_counted_memory;
 
 /**
  * Modern clang complains about obvious self-assignment, but we want
@@ -47,6 +89,17 @@ const T& self_ref(const T& v) {
 }
 }
 
+#ifdef SAJSON_MMAP
+#define VIRTUAL_ALLOCATION_TEST(name)                                    \
+    TEST(virtual_allocation_##name) {                                    \
+        name##internal([](const sajson::string& literal) {               \
+            return sajson::parse(sajson::virtual_allocation(), literal); \
+        });                                                              \
+    }
+#else
+#define VIRTUAL_ALLOCATION_TEST(name)
+#endif
+
 #define ABSTRACT_TEST(name)                                              \
     static void name##internal(                                          \
         sajson::document (*parse)(const sajson::string&));               \
@@ -67,6 +120,51 @@ const T& self_ref(const T& v) {
                 literal);                                                \
         });                                                              \
     }                                                                    \
+    TEST(push_parser_##name) {                                           \
+        name##internal([](const sajson::string& literal) {               \
+            sajson::dynamic_allocation strategy;                         \
+            sajson::push_parser<sajson::dynamic_allocation> parser(      \
+                strategy);                                               \
+            for (size_t i = 0; i < literal.length(); ++i) {              \
+                parser.feed(literal.data() + i, 1);                      \
+            }                                                            \
+            return parser.finish();                                      \
+        });                                                              \
+    }                                                                    \
+    TEST(parse_context_##name) {                                         \
+        name##internal([](const sajson::string& literal) {               \
+            return shared_context.parse(literal);                        \
+        });                                                              \
+    }                                                                    \
+    TEST(custom_memory_##name) {                                         \
+        name##internal([](const sajson::string& literal) {               \
+            return sajson::parse(                                        \
+                sajson::dynamic_allocation(                              \
+                    shared_counted_memory.callbacks()),                  \
+                literal);                                                \
+        });                                                              \
+    }                                                                    \
+    TEST(pooled_allocation_##name) {                                     \
+        name##internal([](const sajson::string& literal) {               \
+            return sajson::parse(sajson::pooled_allocation(), literal);  \
+        });                                                              \
+    }                                                                    \
+    VIRTUAL_ALLOCATION_TEST(name)                                        \
+    TEST(adaptive_allocation_##name) {                                   \
+        name##internal([](const sajson::string& literal) {               \
+            return sajson::parse(                                        \
+                sajson::adaptive_allocation(SIZE_MAX, 0), literal);      \
+        });                                                              \
+    }                                                                    \
+    TEST(right_sized_##name) {                                           \
+        name##internal([](const sajson::string& literal) {               \
+            return sajson::parse(                                        \
+                sajson::single_allocation(),                             \
+                literal,                                                 \
+                sajson::PARSE_RIGHT_SIZED_ALLOCATION                     \
+                    | sajson::PARSE_SHRINK_TO_FIT);                      \
+        });                                                              \
+    }                                                                    \
     static void name##internal(sajson::document (*parse)(const sajson::string&))
 
 ABSTRACT_TEST(empty_array) {
@@ -86,6 +184,28 @@ ABSTRACT_TEST(array_whitespace) {
     CHECK_EQUAL(0u, root.get_length());
 }
 
+ABSTRACT_TEST(whitespace_runs_of_every_length) {
+    // Covers the single-space shortcut, the newline-plus-indentation path,
+    // every SIMD lane, and the scalar tail.
+    for (size_t length = 1; length < 70; ++length) {
+        const std::string indent = "\n" + std::string(length, ' ');
+        std::string mixed;
+        for (size_t i = 0; i < length; ++i) {
+            mixed += " \t\r\n"[i % 4];
+        }
+        const std::string text
+            = mixed + "[" + indent + "1," + mixed + "2" + indent + "]" + mixed;
+        const sajson::document& document
+            = parse(string(text.data(), text.size()));
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(TYPE_ARRAY, root.get_type());
+        CHECK_EQUAL(2u, root.get_length());
+        CHECK_EQUAL(1, root.get_array_element(0).get_integer_value());
+        CHECK_EQUAL(2, root.get_array_element(1).get_integer_value());
+    }
+}
+
 ABSTRACT_TEST(array_zero) {
     const sajson::document& document = parse(literal("[0]"));
     assert(success(document));
@@ -288,10 +408,70 @@ SUITE(integers) {
         CHECK_EQUAL(INT_MIN, min32.get_integer_value());
         CHECK_EQUAL(TYPE_INTEGER, max32.get_type());
         CHECK_EQUAL(INT_MAX, max32.get_integer_value());
-        CHECK_EQUAL(TYPE_DOUBLE, below_min32.get_type());
-        CHECK_EQUAL(double(INT_MIN)-1., below_min32.get_double_value());
-        CHECK_EQUAL(TYPE_DOUBLE, above_max32.get_type());
-        CHECK_EQUAL(double(INT_MAX)+1., above_max32.get_double_value());
+        CHECK_EQUAL(TYPE_INT64, below_min32.get_type());
+        CHECK_EQUAL(INT_MIN - 1LL, below_min32.get_int64_value());
+        CHECK_EQUAL(TYPE_INT64, above_max32.get_type());
+        CHECK_EQUAL(INT_MAX + 1LL, above_max32.get_int64_value());
+    }
+
+    ABSTRACT_TEST(int64_endpoints) {
+        const auto& document = parse(literal(
+            "[-9223372036854775808, 9223372036854775807, "
+            "-9223372036854775809, 9223372036854775808, "
+            "18446744073709551615, 18446744073709551616, "
+            "10000000000000000000, 99999999999999999999, "
+            "12345678901.0, -0, 123]"));
+        assert(success(document));
+        const value& root = document.get_root();
+
+        const value& min64 = root.get_array_element(0);
+        CHECK_EQUAL(TYPE_INT64, min64.get_type());
+        CHECK_EQUAL(INT64_MIN, min64.get_int64_value());
+        CHECK_EQUAL(-9223372036854775808.0, min64.get_number_value());
+
+        const value& max64 = root.get_array_element(1);
+        CHECK_EQUAL(TYPE_INT64, max64.get_type());
+        CHECK_EQUAL(INT64_MAX, max64.get_int64_value());
+
+        const value& below_min64 = root.get_array_element(2);
+        CHECK_EQUAL(TYPE_DOUBLE, below_min64.get_type());
+        CHECK_EQUAL(-9223372036854775808.0, below_min64.get_double_value());
+
+        const value& above_max64 = root.get_array_element(3);
+        CHECK_EQUAL(TYPE_UINT64, above_max64.get_type());
+        CHECK_EQUAL(
+            static_cast<uint64_t>(INT64_MAX) + 1,
+            above_max64.get_uint64_value());
+
+        const value& max_u64 = root.get_array_element(4);
+        CHECK_EQUAL(TYPE_UINT64, max_u64.get_type());
+        CHECK_EQUAL(UINT64_MAX, max_u64.get_uint64_value());
+        CHECK_EQUAL(18446744073709551616.0, max_u64.get_number_value());
+
+        const value& above_max_u64 = root.get_array_element(5);
+        CHECK_EQUAL(TYPE_DOUBLE, above_max_u64.get_type());
+        CHECK_EQUAL(18446744073709551616.0, above_max_u64.get_double_value());
+
+        const value& twenty_digits = root.get_array_element(6);
+        CHECK_EQUAL(TYPE_UINT64, twenty_digits.get_type());
+        CHECK_EQUAL(
+            10000000000000000000ULL, twenty_digits.get_uint64_value());
+
+        const value& twenty_nines = root.get_array_element(7);
+        CHECK_EQUAL(TYPE_DOUBLE, twenty_nines.get_type());
+        CHECK_EQUAL(1e20, twenty_nines.get_double_value());
+
+        const value& fraction = root.get_array_element(8);
+        CHECK_EQUAL(TYPE_DOUBLE, fraction.get_type());
+        CHECK_EQUAL(12345678901.0, fraction.get_double_value());
+
+        const value& negative_zero = root.get_array_element(9);
+        CHECK_EQUAL(TYPE_INTEGER, negative_zero.get_type());
+        CHECK_EQUAL(0, negative_zero.get_integer_value());
+
+        const value& small = root.get_array_element(10);
+        CHECK_EQUAL(TYPE_INTEGER, small.get_type());
+        CHECK_EQUAL(123, small.get_int64_value());
     }
 }
 
@@ -342,8 +522,9 @@ SUITE(doubles) {
         CHECK_EQUAL(1u, root.get_length());
 
         const value& element = root.get_array_element(0);
-        CHECK_EQUAL(TYPE_DOUBLE, element.get_type());
-        CHECK_EQUAL(1496756396000.0, element.get_double_value());
+        CHECK_EQUAL(TYPE_INT64, element.get_type());
+        CHECK_EQUAL(1496756396000LL, element.get_int64_value());
+        CHECK_EQUAL(1496756396000.0, element.get_number_value());
 
         int64_t out;
         CHECK_EQUAL(true, element.get_int53_value(&out));
@@ -380,12 +561,12 @@ SUITE(doubles) {
         CHECK_EQUAL(2u, root.get_length());
 
         const value& e0 = root.get_array_element(0);
-        CHECK_EQUAL(TYPE_DOUBLE, e0.get_type());
-        CHECK_EQUAL(9999999999.0, e0.get_double_value());
+        CHECK_EQUAL(TYPE_INT64, e0.get_type());
+        CHECK_EQUAL(9999999999LL, e0.get_int64_value());
 
         const value& e1 = root.get_array_element(1);
-        CHECK_EQUAL(TYPE_DOUBLE, e1.get_type());
-        CHECK_EQUAL(99999999999.0, e1.get_double_value());
+        CHECK_EQUAL(TYPE_INT64, e1.get_type());
+        CHECK_EQUAL(99999999999LL, e1.get_int64_value());
     }
 
     ABSTRACT_TEST(exponent_offset) {
@@ -400,6 +581,87 @@ SUITE(doubles) {
         CHECK_EQUAL(5.0, e0.get_double_value());
     }
 
+    ABSTRACT_TEST(correctly_rounded) {
+        const auto& document = parse(literal(
+            "[0.1, 0.3, 1e23, 2.2250738585072011e-308, 8.98846567431158e307,"
+            " 9007199254740993e0, 9007199254740993.0000000000000000001,"
+            " 2.4703282292062327e-324, 2.4703282292062328e-324,"
+            " 1.7976931348623158e308, 1.7976931348623159e308,"
+            " 123456789012345678901234567890e-10]"));
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(0.1, root.get_array_element(0).get_double_value());
+        CHECK_EQUAL(0.3, root.get_array_element(1).get_double_value());
+        CHECK_EQUAL(1e23, root.get_array_element(2).get_double_value());
+        CHECK_EQUAL(
+            2.2250738585072011e-308,
+            root.get_array_element(3).get_double_value());
+        CHECK_EQUAL(
+            8.98846567431158e307, root.get_array_element(4).get_double_value());
+        // Exactly halfway: ties round to even.
+        CHECK_EQUAL(
+            9007199254740992.0, root.get_array_element(5).get_double_value());
+        // Just above halfway, beyond the 19th significant digit.
+        CHECK_EQUAL(
+            9007199254740994.0, root.get_array_element(6).get_double_value());
+        CHECK_EQUAL(0.0, root.get_array_element(7).get_double_value());
+        CHECK_EQUAL(
+            4.9406564584124654e-324,
+            root.get_array_element(8).get_double_value());
+        CHECK_EQUAL(
+            1.7976931348623157e308,
+            root.get_array_element(9).get_double_value());
+        CHECK_EQUAL(
+            std::numeric_limits<double>::infinity(),
+            root.get_array_element(10).get_double_value());
+        CHECK_EQUAL(
+            12345678901234567890.123456789,
+            root.get_array_element(11).get_double_value());
+    }
+
+    ABSTRACT_TEST(digits_around_eight_byte_chunks) {
+        const auto& document = parse(literal(
+            "[12345678, 123456789, 1234567890123456789, "
+            "0.00000000123456789, 0.1234567812345678, 12345678.87654321, "
+            "1234567890123456789012e-3, 12345678x]"));
+        CHECK_EQUAL(false, document.is_valid());
+
+        const auto& valid = parse(literal(
+            "[12345678, 123456789, 1234567890123456789, "
+            "0.00000000123456789, 0.1234567812345678, 12345678.87654321, "
+            "1234567890123456789012e-3]"));
+        assert(success(valid));
+        const value& root = valid.get_root();
+        CHECK_EQUAL(12345678, root.get_array_element(0).get_integer_value());
+        CHECK_EQUAL(123456789, root.get_array_element(1).get_integer_value());
+        CHECK_EQUAL(
+            1234567890123456789LL, root.get_array_element(2).get_int64_value());
+        CHECK_EQUAL(
+            0.00000000123456789, root.get_array_element(3).get_double_value());
+        CHECK_EQUAL(
+            0.1234567812345678, root.get_array_element(4).get_double_value());
+        CHECK_EQUAL(
+            12345678.87654321, root.get_array_element(5).get_double_value());
+        CHECK_EQUAL(
+            1234567890123456789.012,
+            root.get_array_element(6).get_double_value());
+    }
+
+    ABSTRACT_TEST(hundreds_of_digits) {
+        // The exact halfway point between 1 and the next double, padded
+        // with zeros past the digits the slow path keeps.
+        const std::string halfway
+            = "1.00000000000000011102230246251565404236316680908203125"
+            + std::string(800, '0');
+        const std::string text = "[" + halfway + ", " + halfway + "1]";
+        const auto& document = parse(string(text.data(), text.size()));
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(1.0, root.get_array_element(0).get_double_value());
+        CHECK_EQUAL(
+            1.0000000000000002, root.get_array_element(1).get_double_value());
+    }
+
     ABSTRACT_TEST(missing_exponent) {
         const sajson::document& document = parse(literal("[0e]"));
         CHECK_EQUAL(false, document.is_valid());
@@ -439,7 +701,7 @@ SUITE(doubles) {
     }
 
     ABSTRACT_TEST(invalid_4_byte_utf8) {
-        const auto& document = parse(literal("[\"\xf7\x8f\x8f\x7f\"]"));
+        const auto& document = parse(literal("[\"\xf0\x9f\x8f\x7f\"]"));
         CHECK_EQUAL(false, document.is_valid());
         CHECK_EQUAL(1u, document.get_error_line());
         CHECK_EQUAL(6u, document.get_error_column());
@@ -455,6 +717,75 @@ SUITE(doubles) {
         CHECK_EQUAL(
             sajson::ERROR_INVALID_UTF8, document._internal_get_error_code());
     }
+
+    ABSTRACT_TEST(ill_formed_utf8) {
+        struct {
+            const char* text;
+            size_t column;
+        } cases[] = {
+            { "[\"\x80\"]", 3 }, // lone continuation
+            { "[\"\xc0\x80\"]", 3 }, // overlong NUL
+            { "[\"\xc1\xbf\"]", 3 }, // overlong 2-byte
+            { "[\"\xe0\x80\xaf\"]", 4 }, // overlong 3-byte
+            { "[\"\xed\xa0\x80\"]", 4 }, // U+D800
+            { "[\"\xed\xbf\xbf\"]", 4 }, // U+DFFF
+            { "[\"\xf0\x8f\xbf\xbf\"]", 4 }, // overlong 4-byte
+            { "[\"\xf4\x90\x80\x80\"]", 4 }, // U+110000
+            { "[\"\xf5\x80\x80\x80\"]", 3 }, // beyond U+10FFFF
+            { "[\"\xe4\xb8\"]", 5 }, // truncated by the closing quote
+        };
+        for (const auto& c : cases) {
+            const auto& document = parse(string(c.text, strlen(c.text)));
+            CHECK_EQUAL(false, document.is_valid());
+            CHECK_EQUAL(c.column, document.get_error_column());
+            CHECK_EQUAL(
+                sajson::ERROR_INVALID_UTF8,
+                document._internal_get_error_code());
+        }
+    }
+
+    ABSTRACT_TEST(utf8_range_boundaries) {
+        const auto& document = parse(literal(
+            "[\"\xc2\x80\xdf\xbf\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80"
+            "\xef\xbf\xbf\xf0\x90\x80\x80\xf4\x8f\xbf\xbf\"]"));
+        assert(success(document));
+        CHECK_EQUAL(
+            "\xc2\x80\xdf\xbf\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80"
+            "\xef\xbf\xbf\xf0\x90\x80\x80\xf4\x8f\xbf\xbf",
+            document.get_root().get_array_element(0).as_string());
+    }
+
+    ABSTRACT_TEST(multibyte_characters_across_block_boundaries) {
+        // Runs of three- and four-byte characters long enough to cross
+        // several SIMD blocks, with an escape first so the run is moved,
+        // and with one byte corrupted at every position.
+        const std::string character[] = { "\xe6\x97\xa5", "\xf0\x9f\x98\x80" };
+        for (const std::string& c : character) {
+            std::string plain;
+            for (size_t i = 0; i < 25; ++i) {
+                plain += c;
+                plain += 'x';
+            }
+
+            std::string text = "[\"" + plain + "\", \"\\t" + plain + "\"]";
+            const auto& document = parse(string(text.data(), text.size()));
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(plain, root.get_array_element(0).as_string());
+            CHECK_EQUAL("\t" + plain, root.get_array_element(1).as_string());
+
+            for (size_t i = 0; i < plain.size(); ++i) {
+                std::string bad = plain;
+                bad[i] = bad[i] == 'x' ? '\x80' : 'x';
+                text = "[\"" + bad + "\"]";
+                const auto& invalid = parse(string(text.data(), text.size()));
+                CHECK_EQUAL(false, invalid.is_valid());
+                CHECK_EQUAL(
+                    sajson::ERROR_INVALID_UTF8,
+                    invalid._internal_get_error_code());
+            }
+        }
+    }
 }
 
 SUITE(int53) {
@@ -493,14 +824,11 @@ SUITE(int53) {
     }
 
     ABSTRACT_TEST(endpoints) {
-        // TODO: What should we do about (1<<53)+1?
-        // When parsed into a double it loses that last bit of precision, so
-        // sajson doesn't distinguish between 9007199254740992 and
-        // 9007199254740993. So for now ignore this boundary condition and unit
-        // test one extra value away.
+        // Integers beyond 32 bits are stored exactly, so the boundary is
+        // precise: (1<<53)+1 is out of range.
         const auto& document
             = parse(literal("[-9007199254740992, 9007199254740992, "
-                            "-9007199254740994, 9007199254740994]"));
+                            "-9007199254740993, 9007199254740993]"));
         assert(success(document));
         const value& root = document.get_root();
         const value& e0 = root.get_array_element(0);
@@ -519,6 +847,17 @@ SUITE(int53) {
         CHECK_EQUAL(false, e2.get_int53_value(&out));
         CHECK_EQUAL(false, e3.get_int53_value(&out));
     }
+
+    ABSTRACT_TEST(uint64) {
+        const auto& document = parse(literal("[18446744073709551615]"));
+        assert(success(document));
+        const value& root = document.get_root();
+        const value& element = root.get_array_element(0);
+        CHECK_EQUAL(TYPE_UINT64, element.get_type());
+
+        int64_t out;
+        CHECK_EQUAL(false, element.get_int53_value(&out));
+    }
 }
 
 SUITE(commas) {
@@ -613,6 +952,83 @@ SUITE(strings) {
         CHECK_EQUAL("foo\tbar", e0.as_cstring());
     }
 
+    ABSTRACT_TEST(special_characters_at_every_offset) {
+        // Puts the byte that ends the fast string scan in every SIMD lane
+        // and in the scalar tail.
+        for (size_t length = 0; length < 70; ++length) {
+            const std::string plain(length, 'a');
+
+            std::string text = "[\"" + plain + "\"]";
+            const auto& quote = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(true, quote.is_valid());
+            CHECK_EQUAL(
+                plain, quote.get_root().get_array_element(0).as_string());
+
+            text = "[\"" + plain + "\\n\"]";
+            const auto& escape = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(true, escape.is_valid());
+            CHECK_EQUAL(
+                plain + "\n",
+                escape.get_root().get_array_element(0).as_string());
+
+            text = "[\"" + plain + "\xc3\xa9\"]";
+            const auto& utf8 = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(true, utf8.is_valid());
+            CHECK_EQUAL(
+                plain + "\xc3\xa9",
+                utf8.get_root().get_array_element(0).as_string());
+
+            text = "[\"" + plain + "\x01\"]";
+            const auto& control = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(false, control.is_valid());
+            CHECK_EQUAL(
+                sajson::ERROR_ILLEGAL_CODEPOINT,
+                control._internal_get_error_code());
+
+            text = "[\"" + plain;
+            const auto& unterminated = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(false, unterminated.is_valid());
+            CHECK_EQUAL(
+                sajson::ERROR_UNEXPECTED_END,
+                unterminated._internal_get_error_code());
+        }
+    }
+
+    ABSTRACT_TEST(escaped_quotes_across_block_boundaries) {
+        // Runs of backslashes before a quote decide whether it closes the
+        // string, including when the run straddles a 64-byte block.
+        for (size_t pad = 0; pad < 140; ++pad) {
+            for (size_t backslashes = 1; backslashes <= 4; ++backslashes) {
+                const std::string text = "[" + std::string(pad, ' ') + "\"a"
+                    + std::string(backslashes, '\\') + "\" \"]";
+                const auto& document = parse(string(text.data(), text.size()));
+                if (backslashes % 2) {
+                    CHECK_EQUAL(true, document.is_valid());
+                    CHECK_EQUAL(
+                        "a" + std::string(backslashes / 2, '\\') + "\" ",
+                        document.get_root().get_array_element(0).as_string());
+                } else {
+                    CHECK_EQUAL(false, document.is_valid());
+                }
+            }
+        }
+    }
+
+    ABSTRACT_TEST(many_empty_strings) {
+        // More quotes than any other byte.
+        std::string text = "[";
+        for (size_t i = 0; i < 1000; ++i) {
+            text += i ? ",\"\"" : "\"\"";
+        }
+        text += ", \"end\" ]";
+        const auto& document = parse(string(text.data(), text.size()));
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(1001u, root.get_length());
+        CHECK_EQUAL("", root.get_array_element(999).as_string());
+        CHECK_EQUAL("end", root.get_array_element(1000).as_string());
+    }
+
     ABSTRACT_TEST(unfinished_string) {
         const sajson::document& document = parse(literal("[\""));
         CHECK_EQUAL(false, document.is_valid());
@@ -673,6 +1089,43 @@ SUITE(strings) {
         CHECK_EQUAL("\xf1\xa4\x8c\xa1", e0.as_cstring());
     }
 
+    ABSTRACT_TEST(consecutive_unicode_escapes) {
+        const auto& document = parse(literal(
+            "[\"\\u0041\\u00e9\\u4E2D\\ud83d\\ude00\\u0000x\\u0042\"]"));
+        assert(success(document));
+        const value& e0 = document.get_root().get_array_element(0);
+        CHECK_EQUAL(13u, e0.get_string_length());
+        CHECK_EQUAL(
+            std::string("A\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\0xB", 13),
+            e0.as_string());
+    }
+
+    ABSTRACT_TEST(invalid_digit_in_consecutive_unicode_escapes) {
+        const auto& document = parse(literal("[\"\\u0041\\u00g9\"]"));
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(1u, document.get_error_line());
+        CHECK_EQUAL(14u, document.get_error_column());
+        CHECK_EQUAL(
+            sajson::ERROR_INVALID_UNICODE_ESCAPE,
+            document._internal_get_error_code());
+    }
+
+    ABSTRACT_TEST(plain_runs_between_escapes) {
+        // After the first escape, plain runs are moved down in bulk.  Cover
+        // run lengths on both sides of the SIMD block sizes.
+        for (size_t length = 0; length < 70; ++length) {
+            const std::string plain(length, 'a');
+            std::string text = "[\"\\n" + plain + "\\u00e9" + plain + "\\t"
+                + plain + "\xe6\x97\xa5" + plain + "\"]";
+            const auto& document = parse(string(text.data(), text.size()));
+            CHECK_EQUAL(true, document.is_valid());
+            CHECK_EQUAL(
+                "\n" + plain + "\xc3\xa9" + plain + "\t" + plain
+                    + "\xe6\x97\xa5" + plain,
+                document.get_root().get_array_element(0).as_string());
+        }
+    }
+
     ABSTRACT_TEST(utf8_shifting) {
         const auto& document
             = parse(literal("[\"\\n\xc2\x80\xe0\xa0\x80\xf0\x90\x80\x80\"]"));
@@ -1068,6 +1521,1118 @@ ABSTRACT_TEST(object_array_with_integers) {
     CHECK_EQUAL(7890U, node2.get_number_value());
 }
 
+SUITE(lazy_strings) {
+    static sajson::document parse_lazy(std::string& text) {
+        return sajson::parse(
+            sajson::single_allocation(),
+            sajson::mutable_string_view(string(text.data(), text.size())),
+            sajson::PARSE_LAZY_STRINGS);
+    }
+
+    TEST(lazy_strings_match_eager_strings) {
+        const std::string source
+            = "[\"plain\", \"\\n\", \"a\\\\b\\\"c\\/d\", \"\\u00e9\\u4e2d\","
+              " \"\\ud83d\\ude00 \\u0000!\", \"\xe6\x97\xa5\\t\xe6\x97\xa5\","
+              " \"x\\by\\fz\\r\"]";
+        std::string eager_text = source;
+        const auto& eager = sajson::parse(
+            sajson::single_allocation(),
+            sajson::mutable_string_view(
+                string(eager_text.data(), eager_text.size())));
+        assert(success(eager));
+        std::string lazy_text = source;
+        const auto& lazy = parse_lazy(lazy_text);
+        assert(success(lazy));
+
+        const value& eager_root = eager.get_root();
+        const value& lazy_root = lazy.get_root();
+        CHECK_EQUAL(eager_root.get_length(), lazy_root.get_length());
+        for (size_t i = 0; i < lazy_root.get_length(); ++i) {
+            const value& expected = eager_root.get_array_element(i);
+            const value& actual = lazy_root.get_array_element(i);
+
+            std::string copy(actual.get_raw_string_length(), '\0');
+            copy.resize(actual.copy_string(&copy[0]));
+            CHECK_EQUAL(expected.as_string(), copy);
+
+            CHECK_EQUAL(
+                expected.get_string_length(), actual.get_string_length());
+            CHECK_EQUAL(expected.as_string(), actual.as_string());
+            CHECK_EQUAL(
+                0, memcmp(
+                       expected.as_cstring(),
+                       actual.as_cstring(),
+                       expected.get_string_length() + 1));
+            CHECK_EQUAL(
+                actual.get_string_length(), actual.get_raw_string_length());
+        }
+    }
+
+    TEST(copy_string_leaves_document_escaped) {
+        std::string text = "[\"a\\nb\"]";
+        const auto& document = parse_lazy(text);
+        assert(success(document));
+        const value& element = document.get_root().get_array_element(0);
+        CHECK_EQUAL(4u, element.get_raw_string_length());
+
+        char buffer[4];
+        CHECK_EQUAL(3u, element.copy_string(buffer));
+        CHECK_EQUAL(0, memcmp("a\nb", buffer, 3));
+        CHECK_EQUAL(4u, element.get_raw_string_length());
+        CHECK_EQUAL(0, memcmp("a\\nb", text.data() + 2, 4));
+
+        CHECK_EQUAL(3u, element.get_string_length());
+        CHECK_EQUAL(3u, element.get_raw_string_length());
+    }
+
+    TEST(object_keys_are_unescaped) {
+        std::string text = "{\"k\\u0065y\": \"v\\u0061lue\", \"a\": 1}";
+        const auto& document = parse_lazy(text);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL("key", root.get_object_key(0).as_string());
+        CHECK_EQUAL(
+            "value", root.get_value_of_key(literal("key")).as_string());
+    }
+
+    TEST(escapes_are_still_validated) {
+        const char* const invalid[] = {
+            "[\"\\x\"]",
+            "[\"\\u12G4\"]",
+            "[\"\\ud800\"]",
+            "[\"\\ud800\\u0041\"]",
+            "[\"\\n\xc0\x80\"]",
+            "[\"\\n\x01\"]",
+        };
+        const sajson::error expected[] = {
+            sajson::ERROR_UNKNOWN_ESCAPE,
+            sajson::ERROR_INVALID_UNICODE_ESCAPE,
+            sajson::ERROR_UNEXPECTED_END_OF_UTF16,
+            sajson::ERROR_INVALID_UTF16_TRAIL_SURROGATE,
+            sajson::ERROR_INVALID_UTF8,
+            sajson::ERROR_ILLEGAL_CODEPOINT,
+        };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+            std::string text = invalid[i];
+            const auto& document = parse_lazy(text);
+            CHECK_EQUAL(false, document.is_valid());
+            CHECK_EQUAL(expected[i], document._internal_get_error_code());
+        }
+    }
+}
+
+SUITE(lazy_numbers) {
+    static sajson::document parse_lazy(std::string& text) {
+        return sajson::parse(
+            sajson::single_allocation(),
+            sajson::mutable_string_view(string(text.data(), text.size())),
+            sajson::PARSE_LAZY_NUMBERS);
+    }
+
+    TEST(lazy_numbers_match_eager_numbers) {
+        const std::string source
+            = "[0, -1, 2147483648, 18446744073709551615, 0.5, -1.25e-3,"
+              " 1E+2, 1e400, -0.0, 2.2250738585072011e-308,"
+              " 0.000000000000000000000000000001234567890123456789012,"
+              " 9007199254740993.000000000000000000000000000001,"
+              " 12345678901234567890123e-3]";
+        std::string eager_text = source;
+        const auto& eager = sajson::parse(
+            sajson::single_allocation(),
+            sajson::mutable_string_view(
+                string(eager_text.data(), eager_text.size())));
+        assert(success(eager));
+        std::string lazy_text = source;
+        const auto& lazy = parse_lazy(lazy_text);
+        assert(success(lazy));
+
+        const value& eager_root = eager.get_root();
+        const value& lazy_root = lazy.get_root();
+        CHECK_EQUAL(eager_root.get_length(), lazy_root.get_length());
+        for (size_t i = 0; i < lazy_root.get_length(); ++i) {
+            const value& expected = eager_root.get_array_element(i);
+            const value& actual = lazy_root.get_array_element(i);
+            CHECK_EQUAL(expected.get_type(), actual.get_type());
+            double expected_number = expected.get_number_value();
+            double actual_number = actual.get_number_value();
+            CHECK_EQUAL(0, memcmp(&expected_number, &actual_number, 8));
+
+            int64_t expected_int53;
+            int64_t actual_int53;
+            CHECK_EQUAL(
+                expected.get_int53_value(&expected_int53),
+                actual.get_int53_value(&actual_int53));
+            CHECK_EQUAL(expected_int53, actual_int53);
+        }
+    }
+
+    TEST(number_text_is_kept_for_doubles) {
+        std::string text = "{\"price\": 19.90, \"count\": 3}";
+        const auto& document = parse_lazy(text);
+        assert(success(document));
+        const value& root = document.get_root();
+
+        const value& price = root.get_value_of_key(literal("price"));
+        CHECK_EQUAL(TYPE_DOUBLE, price.get_type());
+        CHECK(price.has_number_text());
+        CHECK_EQUAL("19.90", price.get_number_text().as_string());
+        CHECK_EQUAL(19.9, price.get_double_value());
+
+        const value& count = root.get_value_of_key(literal("count"));
+        CHECK_EQUAL(TYPE_INTEGER, count.get_type());
+        CHECK(!count.has_number_text());
+    }
+
+    TEST(number_text_is_not_kept_by_default) {
+        const auto& document
+            = sajson::parse(sajson::single_allocation(), literal("[19.90]"));
+        assert(success(document));
+        const value& element = document.get_root().get_array_element(0);
+        CHECK(!element.has_number_text());
+    }
+
+    TEST(numbers_are_still_validated) {
+        const char* const invalid[] = {
+            "[1.]",
+            "[1.e5]",
+            "[1e]",
+            "[-]",
+            "[1.5",
+        };
+        const sajson::error expected[] = {
+            sajson::ERROR_INVALID_NUMBER,
+            sajson::ERROR_INVALID_NUMBER,
+            sajson::ERROR_MISSING_EXPONENT,
+            sajson::ERROR_INVALID_NUMBER,
+            sajson::ERROR_UNEXPECTED_END,
+        };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+            std::string text = invalid[i];
+            const auto& document = parse_lazy(text);
+            CHECK_EQUAL(false, document.is_valid());
+            CHECK_EQUAL(expected[i], document._internal_get_error_code());
+        }
+    }
+}
+
+SUITE(read_only_input) {
+    static sajson::document parse_read_only(
+        const std::string& text, unsigned options = 0) {
+        return sajson::parse(
+            sajson::single_allocation(),
+            string(text.data(), text.size()),
+            sajson::PARSE_READ_ONLY_INPUT | options);
+    }
+
+    TEST(input_is_not_copied_or_modified) {
+        const std::string text
+            = "{\"plain\": \"abc\", \"esc\\u0061ped\": \"x\\ny\\u00e9\"}";
+        const std::string original = text;
+        const auto& document = parse_read_only(text);
+        assert(success(document));
+        CHECK_EQUAL(original, text);
+
+        const value& root = document.get_root();
+        const value& plain = root.get_value_of_key(literal("plain"));
+        CHECK_EQUAL(text.data() + 11, plain.as_cstring());
+        CHECK_EQUAL(3u, plain.get_string_length());
+        CHECK_EQUAL("abc", plain.as_string());
+
+        const value& escaped = root.get_value_of_key(literal("escaped"));
+        CHECK_EQUAL(5u, escaped.get_string_length());
+        CHECK_EQUAL("x\ny\xc3\xa9", escaped.as_string());
+        CHECK_EQUAL(0, memcmp("x\ny\xc3\xa9", escaped.as_cstring(), 6));
+
+        char buffer[16];
+        CHECK_EQUAL(5u, escaped.copy_string(buffer));
+        CHECK_EQUAL(0, memcmp("x\ny\xc3\xa9", buffer, 5));
+    }
+
+    TEST(literals_can_live_in_read_only_memory) {
+        static const char text[] = "[\"a\\tb\", \"c\", {\"\\u0064\": 1}]";
+        const auto& document = sajson::parse(
+            sajson::single_allocation(),
+            literal(text),
+            sajson::PARSE_READ_ONLY_INPUT);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL("a\tb", root.get_array_element(0).as_string());
+        CHECK_EQUAL("c", root.get_array_element(1).as_string());
+        const value& object = root.get_array_element(2);
+        CHECK_EQUAL("d", object.get_object_key(0).as_string());
+    }
+
+    TEST(escaped_keys_are_sorted_and_found) {
+        std::string text = "{";
+        for (int i = 0; i < 150; ++i) {
+            char key[32];
+            snprintf(
+                key, sizeof(key), i % 2 ? "\"k\\u0065y%d\"" : "\"key%d\"", i);
+            text += (i ? ", " : "") + std::string(key) + ": "
+                + std::to_string(i);
+        }
+        text += "}";
+        const auto& document = parse_read_only(text);
+        assert(success(document));
+        const value& root = document.get_root();
+        for (int i = 0; i < 150; ++i) {
+            std::string key = "key" + std::to_string(i);
+            const value& element
+                = root.get_value_of_key(string(key.data(), key.size()));
+            CHECK_EQUAL(TYPE_INTEGER, element.get_type());
+            CHECK_EQUAL(i, element.get_integer_value());
+        }
+    }
+
+    TEST(lazy_strings_are_unescaped_during_the_parse) {
+        const std::string text = "[\"a\\nb\"]";
+        const auto& document
+            = parse_read_only(text, sajson::PARSE_LAZY_STRINGS);
+        assert(success(document));
+        CHECK_EQUAL("[\"a\\nb\"]", text);
+        const value& element = document.get_root().get_array_element(0);
+        CHECK_EQUAL(3u, element.get_raw_string_length());
+        CHECK_EQUAL("a\nb", element.as_string());
+        CHECK_EQUAL("[\"a\\nb\"]", text);
+    }
+
+    TEST(errors_are_still_reported) {
+        const char* const invalid[] = {
+            "[\"\\x\"]",
+            "[\"\\ud800\"]",
+            "[\"a\\n\xc0\x80\"]",
+            "[\"abc",
+        };
+        const sajson::error expected[] = {
+            sajson::ERROR_UNKNOWN_ESCAPE,
+            sajson::ERROR_UNEXPECTED_END_OF_UTF16,
+            sajson::ERROR_INVALID_UTF8,
+            sajson::ERROR_UNEXPECTED_END,
+        };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+            const auto& document = parse_read_only(invalid[i]);
+            CHECK_EQUAL(false, document.is_valid());
+            CHECK_EQUAL(expected[i], document._internal_get_error_code());
+        }
+    }
+}
+
+#ifdef SAJSON_MMAP
+SUITE(parse_file) {
+    class temporary_file {
+    public:
+        explicit temporary_file(const std::string& contents) {
+            strcpy(path, "/tmp/sajson_test_XXXXXX");
+            int fd = mkstemp(path);
+            assert(fd >= 0);
+            ssize_t written = write(fd, contents.data(), contents.size());
+            assert(written == static_cast<ssize_t>(contents.size()));
+            (void)written;
+            close(fd);
+        }
+
+        ~temporary_file() { unlink(path); }
+
+        std::string read() const {
+            std::string contents;
+            FILE* file = fopen(path, "rb");
+            char buffer[256];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                contents.append(buffer, n);
+            }
+            fclose(file);
+            return contents;
+        }
+
+        char path[32];
+    };
+
+    TEST(file_is_parsed_and_left_unmodified) {
+        const std::string contents = "{\"a\\nb\": [1, \"c\\td\", 2.5]}";
+        temporary_file file(contents);
+        const auto& document
+            = sajson::parse_file(sajson::single_allocation(), file.path);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL("a\nb", root.get_object_key(0).as_string());
+        const value& array = root.get_object_value(0);
+        CHECK_EQUAL(1, array.get_array_element(0).get_integer_value());
+        CHECK_EQUAL("c\td", array.get_array_element(1).as_string());
+        CHECK_EQUAL(2.5, array.get_array_element(2).get_double_value());
+        CHECK_EQUAL(contents, file.read());
+    }
+
+    TEST(read_only_mapping) {
+        temporary_file file("[\"x\\u0079z\", \"plain\"]");
+        const auto& document = sajson::parse_file(
+            sajson::dynamic_allocation(),
+            file.path,
+            sajson::PARSE_READ_ONLY_INPUT);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL("xyz", root.get_array_element(0).as_string());
+        CHECK_EQUAL("plain", root.get_array_element(1).as_string());
+    }
+
+    TEST(document_owns_the_mapping) {
+        temporary_file file("[\"moved\"]");
+        std::unique_ptr<document> outer;
+        {
+            document inner
+                = sajson::parse_file(sajson::single_allocation(), file.path);
+            assert(success(inner));
+            outer.reset(new document(std::move(inner)));
+        }
+        CHECK_EQUAL(
+            "moved", outer->get_root().get_array_element(0).as_string());
+    }
+
+    TEST(empty_file) {
+        temporary_file file("");
+        const auto& document
+            = sajson::parse_file(sajson::single_allocation(), file.path);
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_MISSING_ROOT_ELEMENT,
+            document._internal_get_error_code());
+    }
+
+    TEST(missing_file) {
+        const auto& document = sajson::parse_file(
+            sajson::single_allocation(), "/nonexistent/sajson.json");
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_CANNOT_READ_FILE,
+            document._internal_get_error_code());
+        CHECK_EQUAL(ENOENT, document._internal_get_error_argument());
+    }
+}
+#endif
+
+SUITE(push_parser) {
+    typedef sajson::push_parser<sajson::dynamic_allocation> push_parser;
+
+    TEST(every_split_point) {
+        const std::string text = "{\"a\": [true, null, -1.5e3, 12345678901],"
+                                 " \"b\\u00e9\": \"x\\ud83d\\ude00\\\"y\"}";
+        for (size_t split = 0; split <= text.size(); ++split) {
+            sajson::dynamic_allocation strategy;
+            push_parser parser(strategy);
+            CHECK(parser.feed(text.data(), split));
+            CHECK(parser.feed(text.data() + split, text.size() - split));
+            const auto& document = parser.finish();
+            assert(success(document));
+
+            const value& root = document.get_root();
+            const value& a = root.get_value_of_key(literal("a"));
+            CHECK_EQUAL(4u, a.get_length());
+            CHECK_EQUAL(TYPE_TRUE, a.get_array_element(0).get_type());
+            CHECK_EQUAL(TYPE_NULL, a.get_array_element(1).get_type());
+            CHECK_EQUAL(-1500.0, a.get_array_element(2).get_double_value());
+            CHECK_EQUAL(
+                12345678901.0, a.get_array_element(3).get_number_value());
+            const value& b = root.get_value_of_key(literal("b\xc3\xa9"));
+            CHECK_EQUAL("x\xf0\x9f\x98\x80\"y", b.as_string());
+        }
+    }
+
+    TEST(document_owns_the_input) {
+        const std::string text = "[\"kept\", [1, 2, 3]]";
+        std::unique_ptr<document> outer;
+        {
+            sajson::dynamic_allocation strategy;
+            push_parser parser(strategy);
+            for (size_t i = 0; i < text.size(); i += 3) {
+                parser.feed(
+                    text.data() + i, std::min<size_t>(3, text.size() - i));
+            }
+            outer.reset(new document(parser.finish()));
+        }
+        assert(success(*outer));
+        const value& root = outer->get_root();
+        CHECK_EQUAL("kept", root.get_array_element(0).as_string());
+        CHECK_EQUAL(3u, root.get_array_element(1).get_length());
+    }
+
+    TEST(input_buffer_grows) {
+        std::string text = "[";
+        for (int i = 0; i < 5000; ++i) {
+            text += (i ? ", " : "") + std::string("\"s") + std::to_string(i)
+                + "\", " + std::to_string(i);
+        }
+        text += "]";
+        sajson::dynamic_allocation strategy;
+        push_parser parser(strategy);
+        for (size_t i = 0; i < text.size(); i += 7) {
+            CHECK(parser.feed(
+                text.data() + i, std::min<size_t>(7, text.size() - i)));
+        }
+        const auto& document = parser.finish();
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(10000u, root.get_length());
+        CHECK_EQUAL("s4999", root.get_array_element(9998).as_string());
+        CHECK_EQUAL(4999, root.get_array_element(9999).get_integer_value());
+    }
+
+    TEST(errors_are_reported_before_finish) {
+        sajson::dynamic_allocation strategy;
+        push_parser parser(strategy);
+        CHECK(parser.feed(literal("[1, 2")));
+        CHECK(parser.feed(literal(" x")));
+        CHECK(!parser.feed(literal("]")));
+        CHECK(!parser.feed(literal("]")));
+        const auto& document = parser.finish();
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_COMMA, document._internal_get_error_code());
+        CHECK_EQUAL(1u, document.get_error_line());
+        CHECK_EQUAL(7u, document.get_error_column());
+    }
+
+    TEST(truncated_literal_waits_for_more_input) {
+        // Whether "t ]" is cut off or misspelled depends on what follows.
+        sajson::dynamic_allocation strategy;
+        push_parser parser(strategy);
+        CHECK(parser.feed(literal("[t ]")));
+        CHECK(!parser.feed(literal("\n\n")));
+        const auto& document = parser.finish();
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_TRUE, document._internal_get_error_code());
+
+        push_parser short_parser(strategy);
+        CHECK(short_parser.feed(literal("[t ]")));
+        const auto& short_document = short_parser.finish();
+        CHECK_EQUAL(
+            sajson::ERROR_UNEXPECTED_END,
+            short_document._internal_get_error_code());
+        CHECK_EQUAL(2u, short_document.get_error_column());
+    }
+
+    TEST(trailing_input_after_the_root) {
+        sajson::dynamic_allocation strategy;
+        push_parser parser(strategy);
+        CHECK(parser.feed(literal("{} ")));
+        CHECK(!parser.feed(literal("[] ")));
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_END_OF_INPUT,
+            parser.finish()._internal_get_error_code());
+    }
+
+    TEST(empty_input) {
+        sajson::dynamic_allocation strategy;
+        push_parser parser(strategy);
+        CHECK(parser.feed(literal(" \n")));
+        CHECK_EQUAL(
+            sajson::ERROR_MISSING_ROOT_ELEMENT,
+            parser.finish()._internal_get_error_code());
+    }
+
+    TEST(single_allocation_is_sized_by_expected_length) {
+        sajson::single_allocation strategy;
+        sajson::push_parser<sajson::single_allocation> parser(
+            strategy, sajson::PARSE_DEFAULT, 8);
+        CHECK(parser.feed(literal("[1, ")));
+        CHECK(parser.feed(literal("2]  ")));
+        assert(success(parser.finish()));
+
+        sajson::push_parser<sajson::single_allocation> small_parser(
+            strategy, sajson::PARSE_DEFAULT, 8);
+        CHECK(small_parser.feed(literal("[1, ")));
+        CHECK(!small_parser.feed(literal("2, 3]")));
+        CHECK_EQUAL(
+            sajson::ERROR_OUT_OF_MEMORY,
+            small_parser.finish()._internal_get_error_code());
+    }
+
+#ifdef SAJSON_MMAP
+    TEST(virtual_allocation_is_sized_by_expected_length) {
+        std::string text = "[";
+        for (int i = 0; i < 50000; ++i) {
+            text += (i ? ", " : "") + std::to_string(i);
+        }
+        text += "]";
+        sajson::virtual_allocation strategy;
+        sajson::push_parser<sajson::virtual_allocation> parser(
+            strategy, sajson::PARSE_DEFAULT, text.size());
+        for (size_t i = 0; i < text.size(); i += 100) {
+            CHECK(parser.feed(
+                text.data() + i, std::min<size_t>(100, text.size() - i)));
+        }
+        const auto& document = parser.finish();
+        assert(success(document));
+        CHECK_EQUAL(50000u, document.get_root().get_length());
+
+        sajson::push_parser<sajson::virtual_allocation> small_parser(
+            strategy, sajson::PARSE_DEFAULT, 50);
+        CHECK(!small_parser.feed(text.data(), 100));
+        CHECK_EQUAL(
+            sajson::ERROR_OUT_OF_MEMORY,
+            small_parser.finish()._internal_get_error_code());
+    }
+#endif
+}
+
+SUITE(document_stream) {
+    TEST(newline_delimited) {
+        sajson::document_stream stream(
+            literal("{\"a\": 1}\n[2, \"x\\ny\"]\r\n\n{}\n"));
+        CHECK_EQUAL(0u, stream.get_offset());
+
+        CHECK(stream.has_next());
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            CHECK_EQUAL(
+                1,
+                document.get_root()
+                    .get_value_of_key(literal("a"))
+                    .get_integer_value());
+        }
+        CHECK_EQUAL(9u, stream.get_offset());
+
+        CHECK(stream.has_next());
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(2, root.get_array_element(0).get_integer_value());
+            CHECK_EQUAL("x\ny", root.get_array_element(1).as_string());
+        }
+        CHECK_EQUAL(23u, stream.get_offset());
+
+        CHECK(stream.has_next());
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            CHECK_EQUAL(TYPE_OBJECT, document.get_root().get_type());
+        }
+        CHECK(!stream.has_next());
+    }
+
+    TEST(concatenated) {
+        sajson::document_stream stream(literal("[1][2]{\n  \"k\": [3]\n}[]"));
+        std::vector<size_t> lengths;
+        while (stream.has_next()) {
+            const document& document = stream.next();
+            assert(success(document));
+            lengths.push_back(document.get_root().get_length());
+        }
+        CHECK_EQUAL(4u, lengths.size());
+        CHECK_EQUAL(1u, lengths[0]);
+        CHECK_EQUAL(1u, lengths[1]);
+        CHECK_EQUAL(1u, lengths[2]);
+        CHECK_EQUAL(0u, lengths[3]);
+    }
+
+    TEST(buffer_grows_for_large_documents) {
+        std::string text = "[1]\n[";
+        for (int i = 0; i < 5000; ++i) {
+            text += (i ? ", " : "") + std::to_string(i);
+        }
+        text += "]\n{\"x\": [true]}\n";
+        sajson::document_stream stream(string(text.data(), text.size()));
+
+        CHECK_EQUAL(1u, stream.next().get_root().get_length());
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(5000u, root.get_length());
+            CHECK_EQUAL(4999, root.get_array_element(4999).get_integer_value());
+        }
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            const value& x = document.get_root().get_value_of_key(literal("x"));
+            CHECK_EQUAL(TYPE_TRUE, x.get_array_element(0).get_type());
+        }
+        CHECK(!stream.has_next());
+    }
+
+    TEST(buffer_grows_while_installing_containers) {
+        std::string text = "[";
+        for (int i = 0; i < 2000; ++i) {
+            text += (i ? ", " : "") + std::to_string(i);
+        }
+        text += "]\n{";
+        for (int i = 0; i < 2000; ++i) {
+            text += (i ? ", \"k" : "\"k") + std::to_string(i) + "\": 1";
+        }
+        text += "}\n";
+        sajson::document_stream stream(string(text.data(), text.size()));
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(2000u, root.get_length());
+            CHECK_EQUAL(1999, root.get_array_element(1999).get_integer_value());
+        }
+        {
+            const document& document = stream.next();
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(2000u, root.get_length());
+            CHECK_EQUAL(
+                1, root.get_value_of_key(literal("k1999")).get_integer_value());
+        }
+        CHECK(!stream.has_next());
+    }
+
+    TEST(stops_after_an_error) {
+        sajson::document_stream stream(literal("[1]\n[2,]\n[3]\n"));
+        CHECK(success(stream.next()));
+        CHECK(stream.has_next());
+        const document& document = stream.next();
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_VALUE, document._internal_get_error_code());
+        CHECK_EQUAL(1u, document.get_error_line());
+        CHECK_EQUAL(4u, document.get_error_column());
+        CHECK_EQUAL(4u, stream.get_offset());
+        CHECK(!stream.has_next());
+    }
+
+    TEST(whitespace_only) {
+        sajson::document_stream empty(literal(""));
+        CHECK(!empty.has_next());
+        sajson::document_stream blank(literal(" \n\t\n"));
+        CHECK(!blank.has_next());
+    }
+}
+
+SUITE(parse_context) {
+    TEST(reuses_buffers) {
+        sajson::parse_context context;
+        const sajson::ast_word* first_root;
+        const char* first_input;
+        {
+            const document& document = context.parse(literal("[1, \"a\"]"));
+            assert(success(document));
+            first_root = document._internal_get_root();
+            first_input = document._internal_get_input().get_data();
+        }
+        const document& document = context.parse(literal("[2, \"b\"]"));
+        assert(success(document));
+        CHECK_EQUAL(first_root, document._internal_get_root());
+        CHECK(first_input == document._internal_get_input().get_data());
+        const value& root = document.get_root();
+        CHECK_EQUAL(2, root.get_array_element(0).get_integer_value());
+        CHECK_EQUAL("b", root.get_array_element(1).as_string());
+    }
+
+    TEST(grows_for_large_documents) {
+        std::string large = "[";
+        for (int i = 0; i < 5000; ++i) {
+            large += (i ? ", \"" : "\"") + std::to_string(i) + "\\n\"";
+        }
+        large += "]";
+
+        sajson::parse_context context;
+        CHECK(success(context.parse(literal("[1]"))));
+        {
+            const document& document
+                = context.parse(string(large.data(), large.size()));
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(5000u, root.get_length());
+            CHECK_EQUAL("4999\n", root.get_array_element(4999).as_string());
+        }
+        const document& document = context.parse(literal("{\"x\": true}"));
+        assert(success(document));
+        CHECK_EQUAL(
+            TYPE_TRUE,
+            document.get_root().get_value_of_key(literal("x")).get_type());
+    }
+
+    TEST(copies_input) {
+        std::string text = "[\"a\\tb\"]";
+        const std::string original = text;
+        sajson::parse_context context;
+        const document& document
+            = context.parse(string(text.data(), text.size()));
+        assert(success(document));
+        CHECK_EQUAL(
+            "a\tb", document.get_root().get_array_element(0).as_string());
+        CHECK_EQUAL(original, text);
+    }
+
+    TEST(parses_in_place) {
+        char text[] = "[\"a\\tb\"]";
+        sajson::parse_context context;
+        sajson::mutable_string_view view(sizeof(text) - 1, text);
+        const document& document = context.parse(view);
+        assert(success(document));
+        CHECK(text == document._internal_get_input().get_data());
+        CHECK_EQUAL(
+            "a\tb", document.get_root().get_array_element(0).as_string());
+    }
+
+    TEST(recovers_after_an_error) {
+        sajson::parse_context context;
+        const document& bad = context.parse(literal("[1,]"));
+        CHECK_EQUAL(false, bad.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_VALUE, bad._internal_get_error_code());
+
+        const document& good = context.parse(literal("[[]]"));
+        assert(success(good));
+        CHECK_EQUAL(1u, good.get_root().get_length());
+    }
+
+    TEST(input_buffer_failure) {
+        // The input buffer cannot be allocated, so the input is never read.
+        sajson::parse_context context;
+        const document& document
+            = context.parse(string("[]", SIZE_MAX / 2));
+        CHECK_EQUAL(false, document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_OUT_OF_MEMORY, document._internal_get_error_code());
+        assert(success(context.parse(literal("[]"))));
+    }
+
+    TEST(release) {
+        sajson::parse_context context;
+        CHECK(success(context.parse(literal("[1]"))));
+        context.release();
+        const document& document = context.parse(literal("[2]"));
+        assert(success(document));
+        CHECK_EQUAL(
+            2, document.get_root().get_array_element(0).get_integer_value());
+    }
+}
+
+SUITE(parse_batch) {
+    TEST(parses_each_input) {
+        const string inputs[] = {
+            literal("{\"a\": [1, 2.5, \"x\\ty\"], \"b\": null}"),
+            literal("[17]"),
+            literal("[\"plain\"]"),
+            literal("[[], {}, true]"),
+        };
+        const auto& batch = sajson::parse_batch(inputs, 4);
+        CHECK(batch.is_valid());
+        CHECK_EQUAL(4u, batch.size());
+        for (const sajson::batch_document& document : batch) {
+            CHECK(document.is_valid());
+        }
+
+        const value& object = batch[0].get_root();
+        const value& a = object.get_value_of_key(literal("a"));
+        CHECK_EQUAL(2.5, a.get_array_element(1).get_double_value());
+        CHECK_EQUAL("x\ty", a.get_array_element(2).as_string());
+        CHECK_EQUAL(
+            TYPE_NULL, object.get_value_of_key(literal("b")).get_type());
+        CHECK_EQUAL(
+            17, batch[1].get_root().get_array_element(0).get_integer_value());
+        CHECK_EQUAL(
+            "plain", batch[2].get_root().get_array_element(0).as_string());
+        const value& array = batch[3].get_root();
+        CHECK_EQUAL(3u, array.get_length());
+        CHECK_EQUAL(TYPE_OBJECT, array.get_array_element(1).get_type());
+        CHECK_EQUAL(TYPE_TRUE, array.get_array_element(2).get_type());
+    }
+
+    TEST(errors_do_not_stop_the_batch) {
+        const string inputs[] = {
+            literal("[1]"),
+            literal("[1,\n 2 3]"),
+            literal(""),
+            literal("[4]"),
+        };
+        const auto& batch = sajson::parse_batch(inputs, 4);
+        CHECK(batch[0].is_valid());
+        CHECK(!batch[1].is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_EXPECTED_COMMA, batch[1]._internal_get_error_code());
+        CHECK_EQUAL(2u, batch[1].get_error_line());
+        CHECK_EQUAL(4u, batch[1].get_error_column());
+        CHECK_EQUAL(
+            std::string("expected ,"),
+            batch[1].get_error_message_as_cstring());
+        CHECK(!batch[2].is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_MISSING_ROOT_ELEMENT,
+            batch[2]._internal_get_error_code());
+        CHECK(batch[3].is_valid());
+        CHECK_EQUAL(
+            4,
+            batch[3].get_root().get_array_element(0).get_integer_value());
+    }
+
+    TEST(copies_inputs_and_outlives_moves) {
+        std::vector<std::string> messages;
+        for (int i = 0; i < 500; ++i) {
+            messages.push_back(
+                "{\"id\": " + std::to_string(i) + ", \"tags\": [\"t"
+                + std::to_string(i) + "\"]}");
+        }
+        std::vector<string> inputs;
+        for (const std::string& message : messages) {
+            inputs.push_back(string(message.data(), message.size()));
+        }
+        std::unique_ptr<sajson::document_batch> batch;
+        {
+            auto parsed = sajson::parse_batch(
+                inputs.data(), inputs.size(), sajson::PARSE_LAZY_STRINGS);
+            batch.reset(new sajson::document_batch(std::move(parsed)));
+        }
+        messages.clear();
+        CHECK_EQUAL(500u, batch->size());
+        for (int i = 0; i < 500; ++i) {
+            const value& root = (*batch)[i].get_root();
+            CHECK_EQUAL(
+                i, root.get_value_of_key(literal("id")).get_integer_value());
+            CHECK_EQUAL(
+                "t" + std::to_string(i),
+                root.get_value_of_key(literal("tags"))
+                    .get_array_element(0)
+                    .as_string());
+        }
+    }
+
+    TEST(empty_batch) {
+        const auto& batch = sajson::parse_batch(nullptr, 0);
+        CHECK(batch.is_valid());
+        CHECK_EQUAL(0u, batch.size());
+        CHECK(batch.begin() == batch.end());
+    }
+}
+
+SUITE(parse_lines_parallel) {
+    // Lines of uneven length, some blank and one invalid, and the sum of the
+    // integers on each, as a sequential parse sees them.  Every line has
+    // escaped line breaks, which are unescaped in place.
+    static std::string make_lines(std::vector<std::pair<size_t, int>>& sums) {
+        std::string text;
+        for (int i = 0; i < 3000; ++i) {
+            if (i % 97 == 0) {
+                text += " \r\n";
+                continue;
+            }
+            size_t offset = text.size();
+            if (i == 1234) {
+                text += "[1, ]\n";
+                sums.emplace_back(offset, -1);
+                continue;
+            }
+            text += "{\"s\": \"\\n\\n\", \"n\": [";
+            int sum = 0;
+            for (int j = 0; j < i % 23; ++j) {
+                text += (j ? ", " : "") + std::to_string(i + j);
+                sum += i + j;
+            }
+            text += "]}\n";
+            sums.emplace_back(offset, sum);
+        }
+        text += "[7]";
+        sums.emplace_back(text.size() - 3, 7);
+        return text;
+    }
+
+    static int sum_of(const document& document) {
+        if (!document.is_valid()) {
+            return -1;
+        }
+        const value& root = document.get_root();
+        const value& numbers = root.get_type() == TYPE_OBJECT
+            ? root.get_value_of_key(literal("n"))
+            : root;
+        int sum = 0;
+        for (size_t i = 0; i < numbers.get_length(); ++i) {
+            sum += numbers.get_array_element(i).get_integer_value();
+        }
+        return sum;
+    }
+
+    TEST(in_order) {
+        std::vector<std::pair<size_t, int>> expected;
+        const std::string text = make_lines(expected);
+        for (size_t chunk_size : {size_t(1), size_t(100), size_t(4096)}) {
+            sajson::parallel_options options;
+            options.thread_count = 4;
+            options.chunk_size = chunk_size;
+            std::vector<std::pair<size_t, int>> actual;
+            sajson::parse_lines_parallel(
+                string(text.data(), text.size()),
+                [&](size_t offset, const document& document) {
+                    actual.emplace_back(offset, sum_of(document));
+                },
+                options);
+            CHECK(expected == actual);
+        }
+    }
+
+    TEST(any_order) {
+        std::vector<std::pair<size_t, int>> expected;
+        const std::string text = make_lines(expected);
+        for (size_t chunk_size : {size_t(1), size_t(100), size_t(4096)}) {
+            sajson::parallel_options options;
+            options.thread_count = 4;
+            options.chunk_size = chunk_size;
+            options.in_order = false;
+            std::mutex mutex;
+            std::vector<std::pair<size_t, int>> actual;
+            sajson::parse_lines_parallel(
+                string(text.data(), text.size()),
+                [&](size_t offset, const document& document) {
+                    int sum = sum_of(document);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    actual.emplace_back(offset, sum);
+                },
+                options);
+            std::sort(actual.begin(), actual.end());
+            CHECK(expected == actual);
+        }
+    }
+
+    TEST(empty_input) {
+        size_t count = 0;
+        sajson::parse_lines_parallel(
+            literal(""), [&](size_t, const document&) { ++count; });
+        sajson::parse_lines_parallel(
+            literal("\n \n"), [&](size_t, const document&) { ++count; });
+        CHECK_EQUAL(0u, count);
+    }
+}
+
+SUITE(parse_parallel) {
+    static bool same_value(const value& a, const value& b) {
+        if (a.get_type() != b.get_type()) {
+            return false;
+        }
+        switch (a.get_type()) {
+        case TYPE_ARRAY:
+            if (a.get_length() != b.get_length()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.get_length(); ++i) {
+                if (!same_value(
+                        a.get_array_element(i), b.get_array_element(i))) {
+                    return false;
+                }
+            }
+            return true;
+        case TYPE_OBJECT:
+            if (a.get_length() != b.get_length()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.get_length(); ++i) {
+                if (a.get_object_key(i).as_string()
+                        != b.get_object_key(i).as_string()
+                    || !same_value(
+                        a.get_object_value(i), b.get_object_value(i))) {
+                    return false;
+                }
+            }
+            return true;
+        case TYPE_STRING:
+            return a.as_string() == b.as_string();
+        case TYPE_INTEGER:
+        case TYPE_DOUBLE:
+            return a.get_number_value() == b.get_number_value();
+        default:
+            return true;
+        }
+    }
+
+    // Checks that parse_parallel agrees with parse, errors included.
+    static void check_parse(const std::string& text, size_t chunk_size) {
+        sajson::parallel_options options;
+        options.thread_count = 4;
+        options.chunk_size = chunk_size;
+        const sajson::document expected = sajson::parse(
+            sajson::single_allocation(), string(text.data(), text.size()));
+        const sajson::document actual = sajson::parse_parallel(
+            string(text.data(), text.size()), options);
+        CHECK_EQUAL(expected.is_valid(), actual.is_valid());
+        if (expected.is_valid() && actual.is_valid()) {
+            CHECK(same_value(expected.get_root(), actual.get_root()));
+        } else {
+            CHECK_EQUAL(
+                expected.get_error_message_as_string(),
+                actual.get_error_message_as_string());
+            CHECK_EQUAL(expected.get_error_line(), actual.get_error_line());
+            CHECK_EQUAL(
+                expected.get_error_column(), actual.get_error_column());
+        }
+    }
+
+    // A root array whose elements have commas, brackets, quotes, and
+    // backslashes in strings, and commas in nested structures.
+    static std::string make_array(size_t count) {
+        static const char* const elements[] = {
+            "{\"id\": 1, \"tags\": [\"a,b\", \"]\"], \"ok\": true}",
+            "\"x\\\"],[{\"",
+            "\"\\\\\"",
+            "[[1, 2], {\"\\\\\": [null, false]}]",
+            "-12.5e3",
+            "\"\\u00e9\\n, \\ud83d\\ude00\"",
+            "{}",
+            "[]",
+            "null",
+        };
+        const size_t element_count = sizeof(elements) / sizeof(*elements);
+        std::string text = " [";
+        for (size_t i = 0; i < count; ++i) {
+            text += i ? (i % 7 ? "," : " ,\n") : "";
+            text += elements[i % element_count];
+        }
+        return text + "]\n";
+    }
+
+    TEST(matches_parse) {
+        const std::string text = make_array(1000);
+        CHECK(sajson::parse(
+                  sajson::single_allocation(),
+                  string(text.data(), text.size()))
+                  .is_valid());
+        for (size_t chunk_size : {1, 10, 64, 100, 4096, 1 << 20}) {
+            check_parse(text, chunk_size);
+        }
+    }
+
+    TEST(errors_match_parse) {
+        const std::string text = make_array(1000);
+        const size_t middle = text.find(",", text.size() / 2);
+        const char* const errors[]
+            = {",,", ", tr", ", tru,e", ", [1,]", ", \"\\x\"", "]", "}"};
+        for (const char* error : errors) {
+            std::string invalid = text;
+            invalid.insert(middle, error);
+            for (size_t chunk_size : {1, 10, 100}) {
+                check_parse(invalid, chunk_size);
+            }
+        }
+        check_parse(text + ", 1", 100);
+        check_parse(text.substr(0, text.size() - 2), 100);
+    }
+
+    // Control bytes differ from quotes and commas only in bit 5, which the
+    // scalar split scan must not ignore.
+    TEST(control_bytes_match_parse) {
+        const std::string text = make_array(1000);
+        const size_t middle = text.find(",", text.size() / 2);
+        const char* const errors[]
+            = {"\x0c", ", \x0c1", ", \x02", ", \"\x02\"", ", [\x02, 1]"};
+        for (const char* error : errors) {
+            std::string invalid = text;
+            invalid.insert(middle, error);
+            for (size_t chunk_size : {1, 10, 100}) {
+                check_parse(invalid, chunk_size);
+            }
+        }
+    }
+
+    TEST(small_documents_and_other_roots) {
+        check_parse("{\"a\": [1, 2, 3], \"b\": [4, 5, 6]}", 1);
+        check_parse("  \"a,b,c\"  ", 1);
+        check_parse("", 1);
+        check_parse("[1, 2, 3]", 1);
+    }
+}
+
 SUITE(api) {
     TEST(mutable_string_view_assignment) {
         sajson::mutable_string_view one(sajson::literal("hello"));
@@ -1098,7 +2663,7 @@ SUITE(api) {
 
 SUITE(allocator_tests) {
     TEST(single_allocation_into_existing_memory) {
-        size_t buffer[2];
+        sajson::ast_word buffer[2];
         const sajson::document& document
             = sajson::parse(sajson::single_allocation(buffer), literal("[]"));
         assert(success(document));
@@ -1115,7 +2680,7 @@ SUITE(allocator_tests) {
         // and AST memory ranges, but it works because install_array and
         // install_object are careful to shift back-to-front.  However,
         // the bounded allocator disallows any overlapping ranges.
-        size_t buffer[5];
+        sajson::ast_word buffer[5];
         const auto& document = sajson::parse(
             sajson::bounded_allocation(buffer), literal("[[]]"));
         assert(success(document));
@@ -1134,13 +2699,356 @@ SUITE(allocator_tests) {
         // and AST memory ranges, but it works because install_array and
         // install_object are careful to shift back-to-front.  However,
         // the bounded allocator disallows any overlapping ranges.
-        size_t buffer[4];
+        sajson::ast_word buffer[4];
         const auto& document = sajson::parse(
             sajson::bounded_allocation(buffer), literal("[[]]"));
         CHECK(!document.is_valid());
         CHECK_EQUAL(
             sajson::ERROR_OUT_OF_MEMORY, document._internal_get_error_code());
     }
+
+#ifdef SAJSON_32BIT_AST
+    TEST(32bit_ast_rejects_inputs_beyond_its_offsets) {
+        CHECK_EQUAL(4u, sizeof(sajson::ast_word));
+        // The length is rejected before any input is read, so the buffer's
+        // pages are never touched.
+        const size_t length = sajson::internal::max_input_length + 1;
+        std::unique_ptr<char[]> text(new char[length]);
+        const auto& document = sajson::parse(
+            sajson::bounded_allocation(ast_buffer, ast_buffer_size),
+            sajson::mutable_string_view(length, text.get()));
+        CHECK(!document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_DOCUMENT_TOO_LARGE,
+            document._internal_get_error_code());
+    }
+#endif
+
+    TEST(worst_case_word_count_ignores_string_contents) {
+        const size_t number = 2 + sajson::double_storage::word_length;
+        CHECK_EQUAL(0u, sajson::worst_case_word_count(literal("")));
+        CHECK_EQUAL(8u, sajson::worst_case_word_count(literal("[[]]")));
+        CHECK_EQUAL(
+            4u * 2 + 4 * 1,
+            sajson::worst_case_word_count(literal("[\"[{,:1 2}]\", \"x\"]")));
+        CHECK_EQUAL(
+            4u * 1 + 4 * 1,
+            sajson::worst_case_word_count(literal("[\"a\\\"[1\\\\\"]")));
+        CHECK_EQUAL(
+            4 * 1 + 4 * 2 + 3 * number,
+            sajson::worst_case_word_count(
+                literal("{\"a\":[1,true,\n-2.5e3]}")));
+    }
+
+    TEST(worst_case_word_count_fits_bounded_allocation) {
+        std::string long_document = "{\"k\": [";
+        for (int i = 0; i < 100; ++i) {
+            long_document += "{\"s\\n\": \"[" + std::to_string(i)
+                + "]\", \"n\": [-1.5, 2, null, false, {}]}, ";
+        }
+        long_document += "[[[[]]]]]}";
+        const char* documents[] = {
+            "[]",
+            "{}",
+            "[[]]",
+            "[1]",
+            "[\"\"]",
+            "{\"a\": {\"b\": [true, \"c\"]}}",
+            "[1, 2, 3, 4, 5, 6, 7, 8, 9, 10]",
+            "[{}, {}, {}, [[], []]]",
+            "[1,2",
+            "{\"a\" 1}",
+            "{\"a\": 1, \"b\"",
+            "[tru",
+            "[1 2]",
+            "[12true]",
+            long_document.c_str(),
+        };
+        for (const char* text : documents) {
+            std::string copy = text;
+            sajson::string input(copy.data(), copy.size());
+            std::vector<sajson::ast_word> buffer(
+                std::max<size_t>(1, sajson::worst_case_word_count(input)));
+            const auto& document = sajson::parse(
+                sajson::bounded_allocation(buffer.data(), buffer.size()),
+                input);
+            CHECK(
+                document.is_valid()
+                || document._internal_get_error_code()
+                    != sajson::ERROR_OUT_OF_MEMORY);
+        }
+    }
+
+    TEST(right_sized_single_allocation_into_existing_memory) {
+        std::string text = "[\"";
+        text.append(100, 'x');
+        text += "\", \"y\"]";
+        sajson::string input(text.data(), text.size());
+        size_t words = sajson::worst_case_word_count(input);
+        CHECK(words < text.size());
+        std::vector<sajson::ast_word> buffer(words);
+
+        const auto& too_small = sajson::parse(
+            sajson::single_allocation(buffer.data(), buffer.size()), input);
+        CHECK_EQUAL(
+            sajson::ERROR_OUT_OF_MEMORY, too_small._internal_get_error_code());
+
+        const auto& document = sajson::parse(
+            sajson::single_allocation(buffer.data(), buffer.size()),
+            input,
+            sajson::PARSE_RIGHT_SIZED_ALLOCATION | sajson::PARSE_SHRINK_TO_FIT);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(2u, root.get_length());
+        CHECK_EQUAL("y", root.get_array_element(1).as_string());
+        // The document does not own the buffer, so it is not shrunk.
+        const sajson::ast_word* ast_root = document._internal_get_root();
+        CHECK(ast_root >= buffer.data());
+        CHECK(ast_root < buffer.data() + buffer.size());
+    }
+
+    TEST(shrink_to_fit) {
+        std::string text = "{\"b\": [1, 2.5, \"three\"], \"a\": {\"c\": null}}";
+        text.append(1000, ' ');
+        const auto& single = sajson::parse(
+            sajson::single_allocation(),
+            string(text.data(), text.size()),
+            sajson::PARSE_SHRINK_TO_FIT);
+        const auto& dynamic = sajson::parse(
+            sajson::dynamic_allocation(),
+            string(text.data(), text.size()),
+            sajson::PARSE_SHRINK_TO_FIT);
+        for (const document* document : { &single, &dynamic }) {
+            assert(success(*document));
+            const value& root = document->get_root();
+            CHECK_EQUAL(2u, root.get_length());
+            const value& b = root.get_value_of_key(literal("b"));
+            CHECK_EQUAL(2.5, b.get_array_element(1).get_double_value());
+            CHECK_EQUAL("three", b.get_array_element(2).as_string());
+            CHECK_EQUAL(
+                TYPE_NULL,
+                root.get_value_of_key(literal("a"))
+                    .get_value_of_key(literal("c"))
+                    .get_type());
+        }
+    }
+
+    TEST(custom_memory_owns_the_ast) {
+        counted_memory memory;
+        {
+            const auto& document = sajson::parse(
+                sajson::dynamic_allocation(memory.callbacks(), 4, 4),
+                literal("[[1, 2], {\"a\": [3, \"b\"]}]"));
+            assert(success(document));
+            // Both buffers grew, and the stack has been freed.
+            CHECK(memory.allocations > 2);
+            CHECK(memory.live_bytes > 0);
+            CHECK_EQUAL(
+                3,
+                document.get_root()
+                    .get_array_element(1)
+                    .get_value_of_key(literal("a"))
+                    .get_array_element(0)
+                    .get_integer_value());
+        }
+        CHECK_EQUAL(0u, memory.live_bytes);
+    }
+
+    TEST(custom_memory_shrinks_into_custom_memory) {
+        counted_memory memory;
+        std::string text = "[1, \"two\", [3.5]]";
+        text.append(1000, ' ');
+        {
+            const auto& document = sajson::parse(
+                sajson::dynamic_allocation(memory.callbacks()),
+                string(text.data(), text.size()),
+                sajson::PARSE_SHRINK_TO_FIT);
+            assert(success(document));
+            CHECK_EQUAL(
+                "two", document.get_root().get_array_element(1).as_string());
+            // Only the exact-size block remains.
+            CHECK(memory.live_bytes < 16 * sizeof(sajson::ast_word));
+        }
+        CHECK_EQUAL(0u, memory.live_bytes);
+    }
+
+    TEST(custom_memory_failure) {
+        sajson::memory_callbacks failing{
+            [](void*, size_t) -> void* { return 0; },
+            [](void*, void*, size_t) {},
+            0,
+        };
+        const auto& document = sajson::parse(
+            sajson::dynamic_allocation(failing), literal("[1, 2, 3]"));
+        CHECK(!document.is_valid());
+        CHECK_EQUAL(
+            sajson::ERROR_OUT_OF_MEMORY, document._internal_get_error_code());
+    }
+
+    TEST(pooled_allocation_reuses_buffers) {
+        const sajson::ast_word* first_root;
+        {
+            const auto& document = sajson::parse(
+                sajson::pooled_allocation(), literal("[1, [2, 3]]"));
+            assert(success(document));
+            first_root = document._internal_get_root();
+        }
+        const auto& document = sajson::parse(
+            sajson::pooled_allocation(), literal("[4, [5, 6]]"));
+        assert(success(document));
+        CHECK(first_root == document._internal_get_root());
+        CHECK_EQUAL(
+            6,
+            document.get_root()
+                .get_array_element(1)
+                .get_array_element(1)
+                .get_integer_value());
+    }
+
+    TEST(pooled_allocation_across_threads) {
+        // Documents may be destroyed on other threads, and blocks larger
+        // than the largest size class bypass the pools.
+        std::string large = "[";
+        for (size_t i = 0; i < 200000; ++i) {
+            large += i ? ",[]" : "[]";
+        }
+        large += "]";
+        std::vector<std::unique_ptr<document>> documents(4);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            threads.emplace_back([&, i] {
+                const std::string& text = i % 2 ? large : std::string("[1]");
+                documents[i].reset(new document(sajson::parse(
+                    sajson::pooled_allocation(),
+                    string(text.data(), text.size()))));
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (size_t i = 0; i < documents.size(); ++i) {
+            assert(success(*documents[i]));
+            CHECK_EQUAL(
+                i % 2 ? 200000u : 1u, documents[i]->get_root().get_length());
+        }
+    }
+
+#ifdef SAJSON_MMAP
+    TEST(virtual_allocation_with_huge_pages) {
+        // A threshold of zero asks for huge pages for every buffer, and the
+        // large root array leaves many stack pages to hand back.
+        std::string text = "[";
+        for (size_t i = 0; i < 200000; ++i) {
+            text += i ? ",[" : "[";
+            text += std::to_string(i);
+            text += "]";
+        }
+        text += "]";
+        const auto& document = sajson::parse(
+            sajson::virtual_allocation(0),
+            string(text.data(), text.size()),
+            sajson::PARSE_SHRINK_TO_FIT);
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(200000u, root.get_length());
+        CHECK_EQUAL(
+            123456,
+            root.get_array_element(123456)
+                .get_array_element(0)
+                .get_integer_value());
+    }
+#endif
+
+    TEST(adaptive_allocation_chooses_by_length_and_budget) {
+        typedef sajson::adaptive_allocation adaptive;
+        const string small = literal("[1, \"long string\", [2]]");
+        size_t words;
+        CHECK_EQUAL(
+            adaptive::LAYOUT_SINGLE, adaptive().choose(small, &words));
+        CHECK_EQUAL(small.length(), words);
+        CHECK_EQUAL(
+            adaptive::LAYOUT_RIGHT_SIZED,
+            adaptive(SIZE_MAX, 0).choose(small, &words));
+        CHECK_EQUAL(sajson::worst_case_word_count(small), words);
+        CHECK_EQUAL(
+            adaptive::LAYOUT_RIGHT_SIZED,
+            adaptive(words * sizeof(sajson::ast_word)).choose(small, &words));
+        CHECK_EQUAL(
+            adaptive::LAYOUT_DYNAMIC,
+            adaptive((words - 1) * sizeof(sajson::ast_word))
+                .choose(small, &words));
+
+#ifdef SAJSON_MMAP
+        // At least one word per input byte, whose count is capped by the
+        // length, makes a 64 MiB buffer.
+        const size_t containers = (64 << 20) / sizeof(sajson::ast_word) / 3;
+        std::string large = "[";
+        for (size_t i = 0; i < containers; ++i) {
+            large += "[],";
+        }
+        large += "[]]";
+        CHECK_EQUAL(
+            adaptive::LAYOUT_VIRTUAL,
+            adaptive().choose(string(large.data(), large.size()), &words));
+#endif
+    }
+
+    TEST(adaptive_allocation_parses_with_each_layout) {
+        std::string text = "[";
+        for (int i = 0; i < 1000; ++i) {
+            text += (i ? ", {\"n\": " : "{\"n\": ") + std::to_string(i)
+                + ", \"s\": \"a\\nb\"}";
+        }
+        text += "]";
+        const string input(text.data(), text.size());
+        const sajson::adaptive_allocation strategies[] = {
+            sajson::adaptive_allocation(),
+            sajson::adaptive_allocation(SIZE_MAX, 0),
+            sajson::adaptive_allocation(1024, 0),
+        };
+        for (const auto& strategy : strategies) {
+            const auto& document = sajson::parse(strategy, input);
+            assert(success(document));
+            const value& root = document.get_root();
+            CHECK_EQUAL(1000u, root.get_length());
+            const value& last = root.get_array_element(999);
+            CHECK_EQUAL(
+                999, last.get_value_of_key(literal("n")).get_integer_value());
+            CHECK_EQUAL(
+                "a\nb", last.get_value_of_key(literal("s")).as_string());
+        }
+    }
+
+    TEST(dynamic_allocation_grows_large_buffers) {
+        // Tiny initial buffers grow on the heap and then, where mremap is
+        // available, into mappings that are remapped as they grow.
+        const size_t count = 200000;
+        std::string text = "[";
+        for (size_t i = 0; i < count; ++i) {
+            text += i ? ", [" : "[";
+            text += std::to_string(i);
+            text += ", \"s\"]";
+        }
+        text += "]";
+        const auto& document = sajson::parse(
+            sajson::dynamic_allocation(16, 16),
+            string(text.data(), text.size()));
+        assert(success(document));
+        const value& root = document.get_root();
+        CHECK_EQUAL(count, root.get_length());
+        for (size_t i = 0; i < count; i += 19997) {
+            const value& element = root.get_array_element(i);
+            CHECK_EQUAL(
+                static_cast<int>(i),
+                element.get_array_element(0).get_integer_value());
+            CHECK_EQUAL("s", element.get_array_element(1).as_string());
+        }
+        CHECK_EQUAL(
+            static_cast<int>(count - 1),
+            root.get_array_element(count - 1)
+                .get_array_element(0)
+                .get_integer_value());
+    }
 }
 
 TEST(zero_initialized_document_is_invalid) {